@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/value.h"
+#include "../include/engine.h"
+#include "../include/tensor.h"
+#include "../include/tape.h"
+#include "../include/parallel_backward.h"
+
+#define SCALAR_WIDTH 64
+#define SCALAR_DEPTH 512
+#define TENSOR_WIDTH 16
+#define TENSOR_DEPTH 4
+#define TENSOR_DIM 96
+#define REPEATS 5
+
+static const int thread_counts[] = {1, 2, 4, 8};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Value *build_scalar_graph(Value **leaves)
+{
+    Value *chains[SCALAR_WIDTH];
+
+    for (int c = 0; c < SCALAR_WIDTH; c++)
+    {
+        Value *x = leaves[c];
+        Value *w = leaves[SCALAR_WIDTH + c];
+        for (int d = 0; d < SCALAR_DEPTH; d++)
+            x = value_tanh(value_add(value_mul(x, w), w));
+        chains[c] = x;
+    }
+
+    return value_sum(chains, SCALAR_WIDTH);
+}
+
+static Value *build_tensor_graph(Tensor **inputs, Tensor *weight)
+{
+    Value *chains[TENSOR_WIDTH];
+
+    for (int c = 0; c < TENSOR_WIDTH; c++)
+    {
+        Tensor *x = inputs[c];
+        for (int d = 0; d < TENSOR_DEPTH; d++)
+            x = tensor_tanh(tensor_matmul(x, weight));
+        chains[c] = tensor_sum(x);
+    }
+
+    return value_sum(chains, TENSOR_WIDTH);
+}
+
+static double time_backward(Value *root, ThreadPool *pool)
+{
+    double best = INFINITY;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now_seconds();
+        if (pool)
+            value_backward_parallel(root, pool);
+        else
+            value_backward(root);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static double max_diff(const double *a, const double *b, size_t n)
+{
+    double worst = 0.0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double d = fabs(a[i] - b[i]);
+        if (d > worst)
+            worst = d;
+    }
+    return worst;
+}
+
+static void report(const char *name, Value *root, size_t nodes, double *(*snapshot)(void *), void *ctx, size_t grad_count)
+{
+    double serial = time_backward(root, NULL);
+    double *reference = snapshot(ctx);
+
+    printf("%-8s %8zu nodes  serial %8.3f ms\n", name, nodes, serial * 1e3);
+
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++)
+    {
+        ThreadPool *pool = thread_pool_create(thread_counts[t]);
+        double elapsed = time_backward(root, pool);
+        double *grads = snapshot(ctx);
+
+        printf("         %2d threads       %8.3f ms  speedup %5.2fx  max |dgrad| %.1e\n",
+               thread_pool_size(pool), elapsed * 1e3, serial / elapsed,
+               max_diff(reference, grads, grad_count));
+
+        free(grads);
+        thread_pool_free(pool);
+    }
+
+    free(reference);
+}
+
+static double *snapshot_scalar(void *ctx)
+{
+    Value **leaves = ctx;
+    double *out = malloc(2 * SCALAR_WIDTH * sizeof(double));
+    for (int i = 0; i < 2 * SCALAR_WIDTH; i++)
+        out[i] = leaves[i]->grad;
+    return out;
+}
+
+static double *snapshot_tensor(void *ctx)
+{
+    Tensor *weight = ctx;
+    double *out = malloc(weight->size * sizeof(double));
+    for (size_t i = 0; i < weight->size; i++)
+        out[i] = weight->grad[i];
+    return out;
+}
+
+/* Backward on a tape graph while another tape, or none, is active must
+   cache the topo on the graph's own tape and give the same gradients. */
+static int check_foreign_tape(Value **leaves, ThreadPool *pool)
+{
+    Tape *owner = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    Tape *other = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+
+    tape_begin(owner);
+    Value *root = build_scalar_graph(leaves);
+    tape_end();
+
+    tape_begin(other);
+    value_backward(root);
+    double *reference = snapshot_scalar(leaves);
+    int ok = tape_owns(owner, root->topo) && !tape_owns(other, root->topo);
+
+    tape_reset(other);
+    for (int i = 0; i < 1024; i++)
+        value_create(0.0);
+    value_backward_parallel(root, pool);
+    tape_end();
+    double *foreign = snapshot_scalar(leaves);
+
+    value_backward(root);
+    double *untaped = snapshot_scalar(leaves);
+
+    double worst = max_diff(reference, foreign, 2 * SCALAR_WIDTH);
+    double d = max_diff(reference, untaped, 2 * SCALAR_WIDTH);
+    if (d > worst)
+        worst = d;
+    ok = ok && worst < 1e-12;
+    printf("foreign-tape backward  topo on owner %s  max |dgrad| %.1e\n", ok ? "yes" : "NO", worst);
+
+    free(reference);
+    free(foreign);
+    free(untaped);
+    tape_free(other);
+    tape_free(owner);
+    return ok;
+}
+
+int main()
+{
+    srand(42);
+
+    Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    tape_begin(tape);
+
+    Value *leaves[2 * SCALAR_WIDTH];
+    for (int i = 0; i < 2 * SCALAR_WIDTH; i++)
+        leaves[i] = value_create((double)rand() / RAND_MAX - 0.5);
+
+    Value *scalar_root = build_scalar_graph(leaves);
+    size_t scalar_nodes = 0;
+    value_topo(scalar_root, &scalar_nodes);
+
+    tape_end();
+
+    size_t shape[2] = {TENSOR_DIM, TENSOR_DIM};
+    Tensor *weight = tensor_create(shape, 2);
+    Tensor *inputs[TENSOR_WIDTH];
+    for (size_t i = 0; i < weight->size; i++)
+        weight->data[i] = ((double)rand() / RAND_MAX - 0.5) / TENSOR_DIM;
+    for (int c = 0; c < TENSOR_WIDTH; c++)
+    {
+        inputs[c] = tensor_create(shape, 2);
+        for (size_t i = 0; i < inputs[c]->size; i++)
+            inputs[c]->data[i] = (double)rand() / RAND_MAX - 0.5;
+    }
+
+    Value *tensor_root = build_tensor_graph(inputs, weight);
+    size_t tensor_nodes = 0;
+    value_topo(tensor_root, &tensor_nodes);
+
+    printf("wide-graph backward: %d logical CPUs\n", thread_pool_default_threads());
+    report("scalar", scalar_root, scalar_nodes, snapshot_scalar, leaves, 2 * SCALAR_WIDTH);
+    report("tensor", tensor_root, tensor_nodes, snapshot_tensor, weight, weight->size);
+
+    ThreadPool *pool = thread_pool_create(2);
+    int ok = check_foreign_tape(leaves, pool);
+    thread_pool_free(pool);
+
+    tape_free(tape);
+    return ok ? 0 : 1;
+}
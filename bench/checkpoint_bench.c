@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/value.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/checkpoint.h"
+
+#define WIDTH 32
+#define DEPTH 64
+#define REPEATS 5
+#define LAYER_PARAMS (WIDTH * WIDTH + WIDTH)
+#define TOLERANCE 1e-9
+
+/* params holds each layer's weights followed by its biases, so a run of
+   layers is one contiguous slice. */
+typedef struct
+{
+    Value **params;
+    int first_layer;
+    int layers;
+} Segment;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int run_layers(void *ctx, Value **inputs, size_t input_count,
+                      Value **outputs, size_t output_count)
+{
+    Segment *seg = ctx;
+    Value *h[WIDTH], *next[WIDTH];
+    (void)input_count;
+    (void)output_count;
+
+    for (int i = 0; i < WIDTH; i++)
+        h[i] = inputs[i];
+
+    for (int l = seg->first_layer; l < seg->first_layer + seg->layers; l++)
+    {
+        for (int o = 0; o < WIDTH; o++)
+        {
+            Value **layer = seg->params + (size_t)l * LAYER_PARAMS;
+            Value *bias = layer[WIDTH * WIDTH + o];
+            next[o] = value_tanh(value_add(value_dot(layer + o * WIDTH, h, WIDTH), bias));
+            if (!next[o])
+                return 0;
+        }
+        for (int i = 0; i < WIDTH; i++)
+            h[i] = next[i];
+    }
+
+    for (int i = 0; i < WIDTH; i++)
+        outputs[i] = h[i];
+    return 1;
+}
+
+static Segment segments[DEPTH];
+
+static Value *build_model(Value **input, Value **params, int every)
+{
+    Value *h[WIDTH];
+    for (int i = 0; i < WIDTH; i++)
+        h[i] = input[i];
+
+    for (int l = 0; l < DEPTH; l += every ? every : DEPTH)
+    {
+        int layers = every ? every : DEPTH;
+        if (l + layers > DEPTH)
+            layers = DEPTH - l;
+
+        Segment *seg = &segments[l];
+        *seg = (Segment){params, l, layers};
+        int ok = every ? value_checkpoint(run_layers, seg, h, WIDTH, params + (size_t)l * LAYER_PARAMS,
+                                          (size_t)layers * LAYER_PARAMS, h, WIDTH)
+                       : run_layers(seg, h, WIDTH, h, WIDTH);
+        if (!ok)
+            return NULL;
+    }
+
+    return value_sum(h, WIDTH);
+}
+
+/* Relative, so vanishing grads cannot hide a mismatch. */
+static double relative_error(double a, double b)
+{
+    double scale = fmax(fmax(fabs(a), fabs(b)), 1e-30);
+    return fabs(a - b) / scale;
+}
+
+int main()
+{
+    srand(42);
+
+    /* Uniform weights with variance 1 / WIDTH and small random biases keep
+       the 64-layer tanh stack from shrinking the gradients to nothing. */
+    size_t param_count = (size_t)DEPTH * LAYER_PARAMS;
+    Value **params = malloc(param_count * sizeof(Value *));
+    Value *input[WIDTH];
+    for (size_t i = 0; i < param_count; i++)
+    {
+        double scale = i % LAYER_PARAMS < WIDTH * WIDTH ? sqrt(3.0 / WIDTH) : 0.1;
+        params[i] = value_create(((double)rand() / RAND_MAX - 0.5) * 2.0 * scale);
+    }
+    for (int i = 0; i < WIDTH; i++)
+        input[i] = value_create((double)rand() / RAND_MAX - 0.5);
+
+    static const int segment_sizes[] = {0, 1, 4, 8, 16};
+    double *reference = malloc(param_count * sizeof(double));
+    double baseline_time = 0.0, scale = 0.0;
+    size_t baseline_bytes = 0;
+    int failed = 0;
+
+    printf("checkpointing: %d layers x %d wide, %zu params\n", DEPTH, WIDTH, param_count);
+    for (size_t s = 0; s < sizeof(segment_sizes) / sizeof(segment_sizes[0]); s++)
+    {
+        int every = segment_sizes[s];
+        Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+        double best = INFINITY, worst = 0.0;
+        size_t tape_bytes = 0;
+        CheckpointStats stats = {0};
+
+        /* Every repeat is compared, so grads that accumulate across
+           backward passes instead of being reset show up as an error. */
+        for (int r = 0; r < REPEATS; r++)
+        {
+            checkpoint_reset_stats();
+            tape_reset(tape);
+            tape_begin(tape);
+
+            double start = now_seconds();
+            Value *out = build_model(input, params, every);
+            if (!out)
+                return 1;
+            value_backward(out);
+            double elapsed = now_seconds() - start;
+
+            tape_end();
+            if (elapsed < best)
+                best = elapsed;
+            tape_bytes = tape->bytes_used;
+            checkpoint_get_stats(&stats);
+
+            for (size_t i = 0; i < param_count; i++)
+            {
+                if (!every && r == 0)
+                {
+                    reference[i] = params[i]->grad;
+                    scale += fabs(reference[i]) / param_count;
+                }
+                double e = relative_error(params[i]->grad, reference[i]);
+                if (e > worst)
+                    worst = e;
+            }
+        }
+        failed |= worst > TOLERANCE;
+
+        size_t peak = tape_bytes + stats.peak_scratch_bytes;
+        if (!every)
+        {
+            baseline_time = best;
+            baseline_bytes = peak;
+            printf("  no checkpoints      %8.2f KiB  %8.3f ms  mean |grad| %.1e\n", peak / 1024.0, best * 1e3,
+                   scale);
+        }
+        else
+        {
+            printf("  every %2d layer(s)   %8.2f KiB  %8.3f ms  memory %5.2fx  time %5.2fx  max rel err %.1e\n",
+                   every, peak / 1024.0, best * 1e3, (double)peak / baseline_bytes,
+                   best / baseline_time, worst);
+        }
+        tape_free(tape);
+    }
+
+    free(reference);
+    for (size_t i = 0; i < param_count; i++)
+        value_free(params[i]);
+    for (int i = 0; i < WIDTH; i++)
+        value_free(input[i]);
+    free(params);
+    if (failed)
+        fprintf(stderr, "[ERROR] Checkpointed gradients differ from the reference\n");
+    return failed;
+}
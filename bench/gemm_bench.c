@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/gemm.h"
+
+typedef struct
+{
+    const char *name;
+    int trans_a;
+    int trans_b;
+    size_t m, n, k;
+} GemmShape;
+
+static const GemmShape shapes[] = {
+    {"digit fwd  X.W^T", 0, 1, 32, 10, 1024},
+    {"digit dX   dY.W", 0, 0, 32, 1024, 10},
+    {"digit dW   dY^T.X", 1, 0, 10, 1024, 32},
+    {"square 128", 0, 0, 128, 128, 128},
+    {"square 256", 0, 0, 256, 256, 256},
+    {"square 512", 0, 0, 512, 512, 512},
+    {"square 1024", 0, 0, 1024, 1024, 1024},
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void gemm_naive(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+                       const real_t *a, size_t lda, const real_t *b, size_t ldb,
+                       real_t *c, size_t ldc)
+{
+    for (size_t i = 0; i < m; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            double acc = 0.0;
+            for (size_t p = 0; p < k; p++)
+            {
+                double av = trans_a ? a[p * lda + i] : a[i * lda + p];
+                double bv = trans_b ? b[j * ldb + p] : b[p * ldb + j];
+                acc += av * bv;
+            }
+            c[i * ldc + j] = acc;
+        }
+    }
+}
+
+static double fill(real_t *buf, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        buf[i] = (double)rand() / RAND_MAX - 0.5;
+    return 0.0;
+}
+
+static double time_call(const GemmShape *s, int naive, const real_t *a, const real_t *b, real_t *c)
+{
+    size_t lda = s->trans_a ? s->m : s->k;
+    size_t ldb = s->trans_b ? s->k : s->n;
+    double flops = 2.0 * s->m * s->n * s->k;
+    int reps = 1;
+    double elapsed = 0.0;
+
+    while (1)
+    {
+        double start = now_seconds();
+        for (int r = 0; r < reps; r++)
+        {
+            if (naive)
+                gemm_naive(s->trans_a, s->trans_b, s->m, s->n, s->k, a, lda, b, ldb, c, s->n);
+            else
+                gemm(s->trans_a, s->trans_b, s->m, s->n, s->k, a, lda, b, ldb, c, s->n, 0);
+        }
+        elapsed = now_seconds() - start;
+        if (elapsed > 0.2)
+            break;
+        reps *= 2;
+    }
+
+    return flops * reps / elapsed * 1e-9;
+}
+
+int main()
+{
+    const GemmIsa isas[] = {GEMM_ISA_SCALAR, GEMM_ISA_AVX2, GEMM_ISA_AVX512};
+
+    printf("%s gemm\n%-18s %8s", REAL_NAME, "shape", "naive");
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++)
+    {
+        if (gemm_set_isa(isas[i]))
+            printf(" %8s", gemm_isa_name());
+    }
+    printf("   (GFLOP/s)  max |err|\n");
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+    {
+        const GemmShape *shape = &shapes[s];
+        real_t *a = malloc(shape->m * shape->k * sizeof(real_t));
+        real_t *b = malloc(shape->k * shape->n * sizeof(real_t));
+        real_t *c = malloc(shape->m * shape->n * sizeof(real_t));
+        real_t *ref = malloc(shape->m * shape->n * sizeof(real_t));
+        if (!a || !b || !c || !ref)
+        {
+            perror("Memory allocation failed");
+            return 1;
+        }
+        fill(a, shape->m * shape->k);
+        fill(b, shape->k * shape->n);
+
+        size_t lda = shape->trans_a ? shape->m : shape->k;
+        size_t ldb = shape->trans_b ? shape->k : shape->n;
+        gemm_naive(shape->trans_a, shape->trans_b, shape->m, shape->n, shape->k, a, lda, b, ldb, ref, shape->n);
+
+        printf("%-18s %8.2f", shape->name, time_call(shape, 1, a, b, c));
+
+        double max_err = 0.0;
+        for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); i++)
+        {
+            if (!gemm_set_isa(isas[i]))
+                continue;
+            printf(" %8.2f", time_call(shape, 0, a, b, c));
+            for (size_t j = 0; j < shape->m * shape->n; j++)
+            {
+                if (fabs(c[j] - ref[j]) > max_err)
+                    max_err = fabs(c[j] - ref[j]);
+            }
+        }
+        printf("              %.1e\n", max_err);
+
+        free(a);
+        free(b);
+        free(c);
+        free(ref);
+    }
+
+    gemm_set_isa(GEMM_ISA_AUTO);
+    return 0;
+}
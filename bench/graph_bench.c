@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/value.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/graph.h"
+#include "../include/fuse.h"
+
+#define INPUTS 256
+#define HIDDEN 64
+#define OUTPUTS 10
+#define CHAIN_WIDTH 64
+#define CHAIN_DEPTH 512
+#define REPEATS 20
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Value *build_layer(Value **in, int n_in, Value **weights, Value **biases,
+                          Value **out, int n_out, int activate)
+{
+    for (int o = 0; o < n_out; o++)
+    {
+        Value *z = value_add(value_dot(in, weights + o * n_in, n_in), biases[o]);
+        out[o] = activate ? value_tanh(z) : z;
+    }
+    return out[0];
+}
+
+static Value *build_chains(Value **leaves)
+{
+    Value *chains[CHAIN_WIDTH];
+
+    for (int c = 0; c < CHAIN_WIDTH; c++)
+    {
+        Value *x = leaves[c];
+        Value *w = leaves[CHAIN_WIDTH + c];
+        for (int d = 0; d < CHAIN_DEPTH; d++)
+            x = value_tanh(value_add(value_mul(x, w), w));
+        chains[c] = x;
+    }
+
+    return value_sum(chains, CHAIN_WIDTH);
+}
+
+/* Same chains with each tanh(x * w + w) step as one fused node. */
+static Value *build_fused_chains(Value **leaves)
+{
+    static FusedKernel step;
+    Value *chains[CHAIN_WIDTH];
+
+    fused_kernel_init(&step);
+    int x = fused_input(&step), w = fused_input(&step);
+    fused_tanh(&step, fused_add(&step, fused_mul(&step, x, w), w));
+
+    for (int c = 0; c < CHAIN_WIDTH; c++)
+    {
+        Value *in[2] = {leaves[c], leaves[CHAIN_WIDTH + c]};
+        for (int d = 0; d < CHAIN_DEPTH; d++)
+            in[0] = value_fused(&step, in);
+        chains[c] = in[0];
+    }
+
+    return value_sum(chains, CHAIN_WIDTH);
+}
+
+/* What naive scalar code produces: a zero seed per accumulator, a constant
+   subtree that evaluates to 1 and the same term rebuilt every step. */
+static Value *build_redundant(Value **leaves)
+{
+    Value *sums[CHAIN_WIDTH];
+
+    for (int c = 0; c < CHAIN_WIDTH; c++)
+    {
+        Value *x = leaves[c];
+        Value *w = leaves[CHAIN_WIDTH + c];
+        Value *acc = value_create(0.0);
+        for (int d = 0; d < CHAIN_DEPTH / 4; d++)
+        {
+            Value *scale = value_mul(value_create(2.0), value_create(0.5));
+            Value *term = value_tanh(value_add(value_mul(x, w), w));
+            acc = value_add(acc, value_mul(term, scale));
+        }
+        sums[c] = acc;
+    }
+
+    return value_sum(sums, CHAIN_WIDTH);
+}
+
+static void report(const char *name, Value *root, Value **leaves, size_t leaf_count, int optimize)
+{
+    size_t nodes = 0;
+    value_topo(root, &nodes);
+
+    Graph *graph = graph_capture(root, leaves, leaf_count, NULL, 0);
+    if (!graph)
+        return;
+
+    GraphOptStats opt = {0};
+    if (optimize && !graph_optimize(graph, &opt))
+    {
+        graph_free(graph);
+        return;
+    }
+
+    double dynamic = INFINITY, replay = INFINITY;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now_seconds();
+        value_backward(root);
+        double elapsed = now_seconds() - start;
+        if (elapsed < dynamic)
+            dynamic = elapsed;
+    }
+
+    double *reference = malloc(leaf_count * sizeof(double));
+    for (size_t i = 0; i < leaf_count; i++)
+        reference[i] = leaves[i]->grad;
+
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now_seconds();
+        graph_backward(graph);
+        double elapsed = now_seconds() - start;
+        if (elapsed < replay)
+            replay = elapsed;
+    }
+
+    double worst = 0.0;
+    for (size_t i = 0; i < leaf_count; i++)
+    {
+        double d = fabs(leaves[i]->grad - reference[i]);
+        if (d > worst)
+            worst = d;
+    }
+
+    printf("%-8s %8zu nodes  %6zu instrs  %5zu runs\n", name,
+           graph_node_count(graph), graph_instr_count(graph), graph_run_count(graph));
+    if (optimize)
+        printf("         graph_optimize  %8zu -> %zu nodes  folded %zu  identities %zu  merged %zu\n",
+               opt.nodes_before, opt.nodes_after, opt.folded, opt.identities, opt.merged);
+    printf("         value_backward  %8.3f ms  %6.2f ns/node\n", dynamic * 1e3, dynamic * 1e9 / nodes);
+    printf("         graph_backward  %8.3f ms  %6.2f ns/node  speedup %5.2fx  max |dgrad| %.1e\n",
+           replay * 1e3, replay * 1e9 / nodes, dynamic / replay, worst);
+
+    free(reference);
+    graph_free(graph);
+}
+
+int main()
+{
+    srand(42);
+
+    size_t param_count = INPUTS * HIDDEN + HIDDEN + HIDDEN * OUTPUTS + OUTPUTS;
+    Value **params = malloc(param_count * sizeof(Value *));
+    Value *input[INPUTS], *hidden[HIDDEN], *logits[OUTPUTS];
+
+    for (size_t i = 0; i < param_count; i++)
+        params[i] = value_create(((double)rand() / RAND_MAX - 0.5) * 0.1);
+    for (int i = 0; i < INPUTS; i++)
+        input[i] = value_create((double)rand() / RAND_MAX);
+
+    Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    tape_begin(tape);
+
+    Value **w1 = params, **b1 = w1 + INPUTS * HIDDEN;
+    Value **w2 = b1 + HIDDEN, **b2 = w2 + HIDDEN * OUTPUTS;
+    build_layer(input, INPUTS, w1, b1, hidden, HIDDEN, 1);
+    build_layer(hidden, HIDDEN, w2, b2, logits, OUTPUTS, 0);
+    Value *loss = value_softmax_cross_entropy(logits, 3, OUTPUTS);
+
+    Value *chain_leaves[2 * CHAIN_WIDTH];
+    for (int i = 0; i < 2 * CHAIN_WIDTH; i++)
+        chain_leaves[i] = value_create((double)rand() / RAND_MAX - 0.5);
+    Value *chains = build_chains(chain_leaves);
+    Value *fused = build_fused_chains(chain_leaves);
+    Value *redundant = build_redundant(chain_leaves);
+
+    report("mlp", loss, params, param_count, 0);
+    report("chains", chains, chain_leaves, 2 * CHAIN_WIDTH, 0);
+    report("fused", fused, chain_leaves, 2 * CHAIN_WIDTH, 0);
+    report("redund", redundant, chain_leaves, 2 * CHAIN_WIDTH, 0);
+    report("redund+o", redundant, chain_leaves, 2 * CHAIN_WIDTH, 1);
+
+    tape_end();
+    tape_free(tape);
+    for (size_t i = 0; i < param_count; i++)
+        value_free(params[i]);
+    for (int i = 0; i < INPUTS; i++)
+        value_free(input[i]);
+    free(params);
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/value.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/dual.h"
+
+#define INPUTS 4
+#define OUTPUTS 512
+#define REPEATS 20
+
+static double weights[OUTPUTS][INPUTS];
+static double x0[INPUTS];
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* y_j = tanh(sum_i w_ji * x_i^2 / (1 + relu(x_i))) */
+static void jacobian_reverse(double jac[OUTPUTS][INPUTS], Tape *tape)
+{
+    tape_reset(tape);
+    tape_begin(tape);
+
+    Value *x[INPUTS], *terms[INPUTS];
+    Value *one = value_create(1.0);
+    for (int i = 0; i < INPUTS; i++)
+        x[i] = value_create(x0[i]);
+
+    for (int j = 0; j < OUTPUTS; j++)
+    {
+        for (int i = 0; i < INPUTS; i++)
+        {
+            Value *num = value_mul(value_create(weights[j][i]), value_pow(x[i], 2.0));
+            terms[i] = value_div(num, value_add(one, value_relu(x[i])));
+        }
+        Value *y = value_tanh(value_sum(terms, INPUTS));
+
+        value_backward(y);
+        for (int i = 0; i < INPUTS; i++)
+            jac[j][i] = x[i]->grad;
+    }
+
+    tape_end();
+}
+
+static void jacobian_dual(double jac[OUTPUTS][INPUTS])
+{
+    Dual one = dual_const(1.0), terms[INPUTS];
+
+    for (int t = 0; t < INPUTS; t++)
+    {
+        Dual x[INPUTS];
+        for (int i = 0; i < INPUTS; i++)
+            x[i] = dual_make(x0[i], i == t ? 1.0 : 0.0);
+
+        for (int j = 0; j < OUTPUTS; j++)
+        {
+            for (int i = 0; i < INPUTS; i++)
+            {
+                Dual num = dual_mul(dual_const(weights[j][i]), dual_pow(x[i], 2.0));
+                terms[i] = dual_div(num, dual_add(one, dual_relu(x[i])));
+            }
+            jac[j][t] = dual_tanh(dual_sum(terms, INPUTS)).dot;
+        }
+    }
+}
+
+static void jacobian_dualvec(double jac[OUTPUTS][INPUTS])
+{
+    DualVec x[INPUTS], terms[INPUTS], one, w, num, den, y;
+    dualvec_const(&one, 1.0);
+    for (int i = 0; i < INPUTS; i++)
+        dualvec_seed(&x[i], x0[i], i);
+
+    for (int j = 0; j < OUTPUTS; j++)
+    {
+        for (int i = 0; i < INPUTS; i++)
+        {
+            dualvec_const(&w, weights[j][i]);
+            dualvec_pow(&num, &x[i], 2.0);
+            dualvec_mul(&num, &w, &num);
+            dualvec_relu(&den, &x[i]);
+            dualvec_add(&den, &one, &den);
+            dualvec_div(&terms[i], &num, &den);
+        }
+        dualvec_sum(&y, terms, INPUTS);
+        dualvec_tanh(&y, &y);
+        for (int i = 0; i < INPUTS; i++)
+            jac[j][i] = y.dot[i];
+    }
+}
+
+static double max_diff(double a[OUTPUTS][INPUTS], double b[OUTPUTS][INPUTS])
+{
+    double worst = 0.0;
+    for (int j = 0; j < OUTPUTS; j++)
+    {
+        for (int i = 0; i < INPUTS; i++)
+        {
+            if (fabs(a[j][i] - b[j][i]) > worst)
+                worst = fabs(a[j][i] - b[j][i]);
+        }
+    }
+    return worst;
+}
+
+int main()
+{
+    static double reverse[OUTPUTS][INPUTS], forward[OUTPUTS][INPUTS], multi[OUTPUTS][INPUTS];
+    double t_reverse = INFINITY, t_forward = INFINITY, t_multi = INFINITY;
+
+    srand(42);
+    for (int i = 0; i < INPUTS; i++)
+        x0[i] = (double)rand() / RAND_MAX - 0.5;
+    for (int j = 0; j < OUTPUTS; j++)
+    {
+        for (int i = 0; i < INPUTS; i++)
+            weights[j][i] = (double)rand() / RAND_MAX - 0.5;
+    }
+
+    Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now_seconds();
+        jacobian_reverse(reverse, tape);
+        double mid = now_seconds();
+        jacobian_dual(forward);
+        double end = now_seconds();
+        jacobian_dualvec(multi);
+        double last = now_seconds();
+
+        if (mid - start < t_reverse)
+            t_reverse = mid - start;
+        if (end - mid < t_forward)
+            t_forward = end - mid;
+        if (last - end < t_multi)
+            t_multi = last - end;
+    }
+    tape_free(tape);
+
+    printf("%dx%d Jacobian\n", OUTPUTS, INPUTS);
+    printf("  reverse (%d backward passes)  %8.3f ms\n", OUTPUTS, t_reverse * 1e3);
+    printf("  dual    (%d forward passes)     %8.3f ms  speedup %6.2fx  max |dJ| %.1e\n",
+           INPUTS, t_forward * 1e3, t_reverse / t_forward, max_diff(reverse, forward));
+    printf("  dualvec (1 forward pass)       %8.3f ms  speedup %6.2fx  max |dJ| %.1e\n",
+           t_multi * 1e3, t_reverse / t_multi, max_diff(reverse, multi));
+    return 0;
+}
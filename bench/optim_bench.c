@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "../include/value.h"
+#include "../include/tensor.h"
+#include "../include/optim.h"
+#include "../include/thread_pool.h"
+
+#define TENSOR_PARAMS (1 << 20)
+#define VALUE_PARAMS 10240
+#define REPEATS 20
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double time_steps(Optimizer *opt)
+{
+    double best = INFINITY;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now_seconds();
+        optim_step(opt);
+        double elapsed = now_seconds() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static void bench_tensor(const char *name, OptimConfig config, int num_threads)
+{
+    size_t shape[1] = {TENSOR_PARAMS};
+    Tensor *t = tensor_create(shape, 1);
+    Optimizer *opt = optim_create(num_threads);
+    for (size_t i = 0; i < t->size; i++)
+    {
+        t->data[i] = (double)rand() / RAND_MAX - 0.5;
+        t->grad[i] = (double)rand() / RAND_MAX - 0.5;
+    }
+
+    optim_add_tensor(opt, t, config);
+    double elapsed = time_steps(opt);
+    printf("tensor %-6s %d thread(s)  %8.3f ms  %6.3f ns/param\n",
+           name, num_threads, elapsed * 1e3, elapsed * 1e9 / TENSOR_PARAMS);
+
+    optim_free(opt);
+    tensor_free(t);
+}
+
+static void bench_values(void)
+{
+    Value **params = malloc(VALUE_PARAMS * sizeof(Value *));
+    for (int i = 0; i < VALUE_PARAMS; i++)
+    {
+        params[i] = value_create((double)rand() / RAND_MAX - 0.5);
+        params[i]->grad = (double)rand() / RAND_MAX - 0.5;
+    }
+
+    double loop = INFINITY;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now_seconds();
+        for (int i = 0; i < VALUE_PARAMS; i++)
+        {
+            double grad = params[i]->grad;
+            if (grad > 1.0)
+                grad = 1.0;
+            if (grad < -1.0)
+                grad = -1.0;
+            params[i]->data -= 1e-3 * grad;
+        }
+        double elapsed = now_seconds() - start;
+        if (elapsed < loop)
+            loop = elapsed;
+    }
+
+    Optimizer *opt = optim_create(1);
+    OptimConfig config = optim_sgd(1e-3, 0.0);
+    config.clip = 1.0;
+    optim_add_values(opt, params, VALUE_PARAMS, config);
+    double fused = time_steps(opt);
+
+    printf("values sgd    hand loop    %8.3f ms  %6.3f ns/param\n", loop * 1e3, loop * 1e9 / VALUE_PARAMS);
+    printf("values sgd    optim_step   %8.3f ms  %6.3f ns/param\n", fused * 1e3, fused * 1e9 / VALUE_PARAMS);
+
+    optim_free(opt);
+    for (int i = 0; i < VALUE_PARAMS; i++)
+        value_free(params[i]);
+    free(params);
+}
+
+int main()
+{
+    srand(42);
+
+    OptimConfig sgd = optim_sgd(1e-3, 0.9);
+    sgd.clip = 1.0;
+    OptimConfig adam = optim_adam(1e-3);
+    OptimConfig adamw = optim_adamw(1e-3, 1e-2);
+
+    int threads = thread_pool_default_threads();
+    bench_tensor("sgd", sgd, 1);
+    bench_tensor("adam", adam, 1);
+    bench_tensor("adamw", adamw, 1);
+    if (threads > 1)
+    {
+        bench_tensor("adam", adam, threads);
+        bench_tensor("adamw", adamw, threads);
+    }
+    bench_values();
+    return 0;
+}
@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "../include/value.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/optim.h"
+#include "../include/export.h"
+
+#define DEFAULT_SIZE 100000
+#define DEFAULT_REPEATS 10
+#define DIGIT_INPUTS 1024
+#define DIGIT_CLASSES 10
+#define DIGIT_PARAMS (DIGIT_INPUTS * DIGIT_CLASSES + DIGIT_CLASSES)
+#define DOT_FILE "suite_bench.dot"
+
+/* Allocation counting: the binary is linked with --wrap for each allocator,
+   so every call made from the library lands here first. */
+static atomic_size_t alloc_calls;
+static atomic_size_t alloc_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_aligned_alloc(size_t align, size_t size);
+int __real_posix_memalign(void **out, size_t align, size_t size);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t n, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void *__wrap_aligned_alloc(size_t align, size_t size);
+int __wrap_posix_memalign(void **out, size_t align, size_t size);
+
+static void count_alloc(size_t size)
+{
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    count_alloc(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    count_alloc(n * size);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    count_alloc(size);
+    return __real_realloc(ptr, size);
+}
+
+void *__wrap_aligned_alloc(size_t align, size_t size)
+{
+    count_alloc(size);
+    return __real_aligned_alloc(align, size);
+}
+
+int __wrap_posix_memalign(void **out, size_t align, size_t size)
+{
+    count_alloc(size);
+    return __real_posix_memalign(out, align, size);
+}
+
+typedef struct
+{
+    int size;
+    Tape *tape;
+    Value *root;
+    Value **leaves;
+    Value **params;
+    Optimizer *opt;
+} Suite;
+
+typedef struct
+{
+    const char *name;
+    void (*prepare)(Suite *s);
+    size_t (*run)(Suite *s);
+} SuiteCase;
+
+typedef struct
+{
+    const char *name;
+    size_t nodes;
+    int repeats;
+    double best_ns;
+    long peak_rss_kib;
+    double allocs;
+    double alloc_bytes;
+} SuiteResult;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Writing 5 to clear_refs resets VmHWM, so each case reports its own peak
+   instead of the high-water mark of everything that ran before it. */
+static void reset_peak_rss(void)
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (!f)
+        return;
+    fputs("5", f);
+    fclose(f);
+}
+
+static long read_peak_rss_kib(void)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    char line[256];
+    long kib = -1;
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "VmHWM: %ld kB", &kib) == 1)
+            break;
+    }
+    fclose(f);
+    return kib;
+}
+
+static double uniform(void)
+{
+    return (double)rand() / RAND_MAX - 0.5;
+}
+
+static void begin_graph(Suite *s)
+{
+    tape_reset(s->tape);
+    tape_begin(s->tape);
+}
+
+/* The cached topo order is dropped each time so the sort is timed too, as
+   it is when a training loop rebuilds its graph every step. Backward runs
+   with the tape active so the new order is allocated on it, not the heap. */
+static size_t backward_root(Suite *s)
+{
+    tape_begin(s->tape);
+    value_invalidate_topo(s->root);
+    value_backward(s->root);
+    tape_end();
+    return s->root->topo_count;
+}
+
+static size_t run_create(Suite *s)
+{
+    begin_graph(s);
+    Value *a = value_create(1.0), *b = value_create(0.5);
+    for (int i = 0; i < s->size; i++)
+        a = value_add(a, b);
+    tape_end();
+    return (size_t)s->size;
+}
+
+static void prepare_chain(Suite *s)
+{
+    begin_graph(s);
+    Value *scale = value_create(0.9), *shift = value_create(0.1);
+    Value *x = value_create(0.5);
+    for (int i = 0; i + 3 <= s->size; i += 3)
+        x = value_tanh(value_add(value_mul(x, scale), shift));
+    s->root = x;
+    tape_end();
+}
+
+static void prepare_tree(Suite *s)
+{
+    begin_graph(s);
+    int n = s->size / 2 > 1 ? s->size / 2 : 2;
+    Value **level = tape_alloc(s->tape, n * sizeof(Value *));
+    for (int i = 0; i < n; i++)
+        level[i] = value_create(uniform());
+
+    for (int depth = 0; n > 1; depth++)
+    {
+        int half = n / 2;
+        for (int i = 0; i < half; i++)
+        {
+            Value *a = level[2 * i], *b = level[2 * i + 1];
+            level[i] = depth % 2 ? value_mul(a, b) : value_add(a, b);
+        }
+        if (n % 2)
+            level[half++] = level[n - 1];
+        n = half;
+    }
+    s->root = level[0];
+    tape_end();
+}
+
+static void prepare_wide(Suite *s)
+{
+    begin_graph(s);
+    int n = s->size / 4 > 0 ? s->size / 4 : 1;
+    Value **terms = tape_alloc(s->tape, n * sizeof(Value *));
+    for (int i = 0; i < n; i++)
+        terms[i] = value_tanh(value_mul(value_create(uniform()), value_create(uniform())));
+    s->root = value_sum(terms, n);
+    tape_end();
+}
+
+static void prepare_softmax(Suite *s)
+{
+    tape_reset(s->tape);
+    s->leaves = realloc(s->leaves, s->size * sizeof(Value *));
+    for (int i = 0; i < s->size; i++)
+        s->leaves[i] = value_create(uniform());
+}
+
+static size_t run_softmax(Suite *s)
+{
+    begin_graph(s);
+    Value *loss = value_softmax_cross_entropy(s->leaves, 0, s->size);
+    value_backward(loss);
+    tape_end();
+    return loss->topo_count;
+}
+
+/* Every leaf feeds a term of the result and a tanh(x^3) branch nobody
+   reads. Eagerly both are computed, while in lazy mode realizing the
+   result never touches the unused branches. */
+static size_t build_branches(Suite *s, int lazy)
+{
+    int n = s->size / 4 > 0 ? s->size / 4 : 1;
+    begin_graph(s);
+    if (lazy)
+        value_lazy_begin();
+
+    Value **terms = tape_alloc(s->tape, n * sizeof(Value *));
+    for (int i = 0; i < n; i++)
+    {
+        Value *x = s->leaves[i % s->size];
+        value_tanh(value_pow(x, 3.0));
+        terms[i] = value_mul(x, x);
+    }
+    Value *root = value_sum(terms, n);
+
+    if (lazy)
+        value_lazy_end();
+    value_realize(root);
+    tape_end();
+    return 4 * (size_t)n + 1;
+}
+
+static size_t run_eager_branches(Suite *s)
+{
+    return build_branches(s, 0);
+}
+
+static size_t run_lazy_branches(Suite *s)
+{
+    return build_branches(s, 1);
+}
+
+static size_t run_dot_export(Suite *s)
+{
+    value_print_full_graph(s->root, DOT_FILE);
+    return s->root->topo_count;
+}
+
+static size_t export_discard(Suite *s, ExportFormat format)
+{
+    FILE *f = fopen("/dev/null", "wb");
+    if (!f)
+        return 0;
+    ExportOptions options = export_options(format, EXPORT_FULL);
+    value_export(s->root, f, &options, NULL);
+    fclose(f);
+    return s->root->topo_count;
+}
+
+static size_t run_json_export(Suite *s)
+{
+    return export_discard(s, EXPORT_JSON);
+}
+
+static size_t run_binary_export(Suite *s)
+{
+    return export_discard(s, EXPORT_BINARY);
+}
+
+static void prepare_train_step(Suite *s)
+{
+    tape_reset(s->tape);
+    s->params = malloc(DIGIT_PARAMS * sizeof(Value *));
+    s->leaves = realloc(s->leaves, DIGIT_INPUTS * sizeof(Value *));
+    for (int i = 0; i < DIGIT_PARAMS; i++)
+        s->params[i] = value_create(i < DIGIT_INPUTS * DIGIT_CLASSES ? uniform() * 0.05 : 0.0);
+    for (int i = 0; i < DIGIT_INPUTS; i++)
+        s->leaves[i] = value_create(uniform() > 0.0 ? 1.0 : 0.0);
+
+    s->opt = optim_create(1);
+    optim_add_values(s->opt, s->params, DIGIT_PARAMS, optim_sgd(0.001, 0.0));
+}
+
+/* One sample of a digit-style linear classifier: forward, backward and an
+   SGD step, rebuilt on the tape every iteration like the example does. */
+static size_t run_train_step(Suite *s)
+{
+    Value *logits[DIGIT_CLASSES];
+    Value **biases = s->params + DIGIT_INPUTS * DIGIT_CLASSES;
+
+    begin_graph(s);
+    for (int i = 0; i < DIGIT_CLASSES; i++)
+        logits[i] = value_add(value_dot(s->leaves, &s->params[i * DIGIT_INPUTS], DIGIT_INPUTS), biases[i]);
+    Value *loss = value_softmax_cross_entropy(logits, 3, DIGIT_CLASSES);
+    value_backward(loss);
+    tape_end();
+
+    optim_step(s->opt);
+    return loss->topo_count;
+}
+
+static void release_case(Suite *s)
+{
+    if (s->params)
+    {
+        for (int i = 0; i < DIGIT_PARAMS; i++)
+            value_free(s->params[i]);
+        for (int i = 0; i < DIGIT_INPUTS; i++)
+            value_free(s->leaves[i]);
+        free(s->params);
+        optim_free(s->opt);
+    }
+    else if (s->leaves && !(s->leaves[0]->flags & VALUE_FLAG_TAPE))
+    {
+        for (int i = 0; i < s->size; i++)
+            value_free(s->leaves[i]);
+    }
+    free(s->leaves);
+    s->leaves = NULL;
+    s->params = NULL;
+    s->opt = NULL;
+    s->root = NULL;
+}
+
+static SuiteResult run_case(Suite *s, const SuiteCase *c, int repeats)
+{
+    SuiteResult r = {c->name, 0, repeats, INFINITY, 0, 0.0, 0.0};
+
+    reset_peak_rss();
+    if (c->prepare)
+        c->prepare(s);
+
+    /* Warm-up iteration: grows scratch buffers and tape blocks once, so the
+       counted iterations show the steady-state allocation rate. */
+    c->run(s);
+
+    size_t calls = atomic_load(&alloc_calls), bytes = atomic_load(&alloc_bytes);
+    for (int i = 0; i < repeats; i++)
+    {
+        double start = now_seconds();
+        r.nodes = c->run(s);
+        double elapsed = (now_seconds() - start) * 1e9;
+        if (elapsed < r.best_ns)
+            r.best_ns = elapsed;
+    }
+    r.allocs = (double)(atomic_load(&alloc_calls) - calls) / repeats;
+    r.alloc_bytes = (double)(atomic_load(&alloc_bytes) - bytes) / repeats;
+    r.peak_rss_kib = read_peak_rss_kib();
+
+    release_case(s);
+    return r;
+}
+
+static void print_results(const SuiteResult *results, int count, int json)
+{
+    if (json)
+        printf("[\n");
+    else
+        printf("case,nodes,repeats,best_ns,ns_per_node,nodes_per_sec,peak_rss_kib,allocs_per_iter,alloc_bytes_per_iter\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        const SuiteResult *r = &results[i];
+        double ns_per_node = r->nodes ? r->best_ns / r->nodes : 0.0;
+        double nodes_per_sec = r->best_ns > 0 ? r->nodes / (r->best_ns * 1e-9) : 0.0;
+
+        if (json)
+        {
+            printf("  {\"case\": \"%s\", \"nodes\": %zu, \"repeats\": %d, \"best_ns\": %.0f, "
+                   "\"ns_per_node\": %.3f, \"nodes_per_sec\": %.0f, \"peak_rss_kib\": %ld, "
+                   "\"allocs_per_iter\": %.1f, \"alloc_bytes_per_iter\": %.0f}%s\n",
+                   r->name, r->nodes, r->repeats, r->best_ns, ns_per_node, nodes_per_sec,
+                   r->peak_rss_kib, r->allocs, r->alloc_bytes, i + 1 < count ? "," : "");
+        }
+        else
+        {
+            printf("%s,%zu,%d,%.0f,%.3f,%.0f,%ld,%.1f,%.0f\n",
+                   r->name, r->nodes, r->repeats, r->best_ns, ns_per_node, nodes_per_sec,
+                   r->peak_rss_kib, r->allocs, r->alloc_bytes);
+        }
+    }
+
+    if (json)
+        printf("]\n");
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--json] [--size N] [--repeats N] [--only CASE]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const SuiteCase cases[] = {
+        {"create", NULL, run_create},
+        {"backward_chain", prepare_chain, backward_root},
+        {"backward_tree", prepare_tree, backward_root},
+        {"backward_wide", prepare_wide, backward_root},
+        {"softmax_ce", prepare_softmax, run_softmax},
+        {"eager_branches", prepare_softmax, run_eager_branches},
+        {"lazy_branches", prepare_softmax, run_lazy_branches},
+        {"dot_export", prepare_chain, run_dot_export},
+        {"json_export", prepare_chain, run_json_export},
+        {"binary_export", prepare_chain, run_binary_export},
+        {"train_step", prepare_train_step, run_train_step},
+    };
+    int case_count = sizeof(cases) / sizeof(cases[0]);
+    int json = 0, size = DEFAULT_SIZE, repeats = DEFAULT_REPEATS;
+    const char *only = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+            json = 1;
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (size < 4 || repeats < 1)
+    {
+        fprintf(stderr, "[ERROR] --size must be at least 4 and --repeats at least 1\n");
+        return 1;
+    }
+
+    srand(42);
+    Suite suite = {size, tape_create(TAPE_DEFAULT_BLOCK_SIZE), NULL, NULL, NULL, NULL};
+    SuiteResult results[sizeof(cases) / sizeof(cases[0])];
+    int count = 0;
+    if (!suite.tape)
+        return 1;
+
+    for (int i = 0; i < case_count; i++)
+    {
+        if (!only || strcmp(only, cases[i].name) == 0)
+            results[count++] = run_case(&suite, &cases[i], repeats);
+    }
+    if (count == 0)
+    {
+        fprintf(stderr, "[ERROR] Unknown case: %s\n", only);
+        return 1;
+    }
+
+    char dot_path[64];
+    snprintf(dot_path, sizeof(dot_path), "output/%s", DOT_FILE);
+    remove(dot_path);
+
+    print_results(results, count, json);
+    tape_free(suite.tape);
+    return 0;
+}
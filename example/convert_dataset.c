@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "dataset.h"
+
+int main(int argc, char **argv)
+{
+    const char *csv_path = "data.csv";
+    const char *bin_path = "data.bin";
+    DatasetPixelType pixel_type = DATASET_PIXEL_F32;
+    int positional = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--u8") == 0)
+            pixel_type = DATASET_PIXEL_U8;
+        else if (positional == 0)
+            csv_path = argv[i], positional++;
+        else if (positional == 1)
+            bin_path = argv[i], positional++;
+        else
+        {
+            fprintf(stderr, "Usage: %s [input.csv] [output.bin] [--u8]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!convert_dataset(csv_path, bin_path, pixel_type))
+    {
+        printf("Failed to convert %s\n", csv_path);
+        return 1;
+    }
+
+    DatasetStore store;
+    if (!load_dataset(bin_path, &store))
+    {
+        printf("Failed to reload %s\n", bin_path);
+        return 1;
+    }
+
+    printf("Wrote %s: %d samples, %d features, %s pixels\n",
+           bin_path, store.count, INPUT_SIZE,
+           pixel_type == DATASET_PIXEL_U8 ? "uint8" : "float32");
+    close_dataset(&store);
+    return 0;
+}
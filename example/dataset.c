@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "dataset.h"
+#include "../include/thread_pool.h"
+
+#define CSV_CHUNKS_PER_THREAD 4
+#define DATASET_ALIGN_UP(x) (((x) + DATASET_ALIGNMENT - 1) & ~(size_t)(DATASET_ALIGNMENT - 1))
+
+typedef struct
+{
+    const char *begin;
+    const char *end;
+    size_t rows;
+    size_t first_row;
+} CsvChunk;
+
+typedef struct
+{
+    CsvChunk *chunks;
+    int chunk_count;
+    atomic_int next;
+
+    float *pixels;
+    int *labels;
+} CsvJob;
+
+static const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* Malformed input saturates here rather than overflowing int. */
+#define PARSE_INT_LIMIT 100000000
+#define PARSE_EXPONENT_LIMIT 400
+
+static const char *parse_int(const char *p, const char *end, int *out)
+{
+    int negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    if (p == end || !is_digit(*p))
+        return NULL;
+
+    int value = 0;
+    for (; p < end && is_digit(*p); p++)
+    {
+        if (value < PARSE_INT_LIMIT)
+            value = value * 10 + (*p - '0');
+    }
+    *out = negative ? -value : value;
+    return p;
+}
+
+static const char *parse_float(const char *p, const char *end, float *out)
+{
+    int negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0;
+
+    for (; p < end && is_digit(*p); p++, digits++)
+    {
+        if (mantissa < UINT64_C(1000000000000000000))
+            mantissa = mantissa * 10 + (*p - '0');
+        else if (exponent < PARSE_EXPONENT_LIMIT)
+            exponent++;
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && is_digit(*p); p++, digits++)
+        {
+            if (mantissa < UINT64_C(1000000000000000000))
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0)
+        return NULL;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        int e;
+        const char *q = parse_int(p + 1, end, &e);
+        if (q)
+        {
+            exponent += e;
+            p = q;
+        }
+    }
+    if (exponent > PARSE_EXPONENT_LIMIT)
+        exponent = PARSE_EXPONENT_LIMIT;
+    else if (exponent < -PARSE_EXPONENT_LIMIT)
+        exponent = -PARSE_EXPONENT_LIMIT;
+
+    double value = (double)mantissa;
+    if (exponent < 0 && exponent >= -22)
+        value /= pow10_table[-exponent];
+    else if (exponent > 0 && exponent <= 22)
+        value *= pow10_table[exponent];
+    else if (exponent != 0)
+        value *= pow(10.0, exponent);
+
+    *out = (float)(negative ? -value : value);
+    return p;
+}
+
+static const char *line_end(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+static int is_blank(const char *p, const char *end)
+{
+    return p == end || (end - p == 1 && *p == '\r');
+}
+
+static int parse_csv_line(const char *p, const char *end, float *image, int *label)
+{
+    p = parse_int(p, end, label);
+    if (!p)
+        return 0;
+
+    for (int i = 0; i < INPUT_SIZE; i++)
+    {
+        if (p == end || *p != ',')
+            return 0;
+        p = parse_float(p + 1, end, &image[i]);
+        if (!p)
+            return 0;
+    }
+    return p == end || *p == '\r';
+}
+
+static void count_chunk_rows(void *ctx, int worker)
+{
+    CsvJob *job = ctx;
+    (void)worker;
+
+    int c;
+    while ((c = atomic_fetch_add(&job->next, 1)) < job->chunk_count)
+    {
+        CsvChunk *chunk = &job->chunks[c];
+        for (const char *p = chunk->begin; p < chunk->end;)
+        {
+            const char *eol = line_end(p, chunk->end);
+            if (!is_blank(p, eol))
+                chunk->rows++;
+            p = eol + 1;
+        }
+    }
+}
+
+static void parse_chunk_rows(void *ctx, int worker)
+{
+    CsvJob *job = ctx;
+    (void)worker;
+
+    int c;
+    while ((c = atomic_fetch_add(&job->next, 1)) < job->chunk_count)
+    {
+        CsvChunk *chunk = &job->chunks[c];
+        size_t row = chunk->first_row;
+        for (const char *p = chunk->begin; p < chunk->end;)
+        {
+            const char *eol = line_end(p, chunk->end);
+            if (!is_blank(p, eol))
+            {
+                if (!parse_csv_line(p, eol, job->pixels + row * INPUT_SIZE, &job->labels[row]))
+                    job->labels[row] = -1;
+                row++;
+            }
+            p = eol + 1;
+        }
+    }
+}
+
+static int split_chunks(const char *begin, const char *end, CsvChunk *chunks, int count)
+{
+    size_t span = (end - begin) / count;
+    const char *p = begin;
+    int used = 0;
+
+    for (int i = 0; i < count && p < end; i++)
+    {
+        const char *stop = i == count - 1 ? end : p + span;
+        if (stop < end)
+            stop = line_end(stop, end) + 1;
+        if (stop > end)
+            stop = end;
+        chunks[used++] = (CsvChunk){p, stop, 0, 0};
+        p = stop;
+    }
+    return used;
+}
+
+static int read_csv(const char *filename, float **out_pixels, int **out_labels, int *out_count)
+{
+    double start = now_seconds();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("Error opening file");
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0)
+    {
+        fprintf(stderr, "[ERROR] %s is empty\n", filename);
+        close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED)
+    {
+        perror("Error mapping file");
+        return 0;
+    }
+    madvise((void *)text, size, MADV_SEQUENTIAL);
+
+    const char *end = text + size;
+    const char *body = line_end(text, end) + 1;
+    if (body > end)
+        body = end;
+
+    ThreadPool *pool = thread_pool_create(0);
+    int threads = thread_pool_size(pool);
+    int chunk_target = threads * CSV_CHUNKS_PER_THREAD;
+    CsvJob job = {0};
+    job.chunks = malloc(chunk_target * sizeof(CsvChunk));
+    if (!pool || !job.chunks)
+    {
+        perror("Memory allocation failed");
+        thread_pool_free(pool);
+        free(job.chunks);
+        munmap((void *)text, size);
+        return 0;
+    }
+    job.chunk_count = split_chunks(body, end, job.chunks, chunk_target);
+
+    atomic_store(&job.next, 0);
+    thread_pool_run(pool, count_chunk_rows, &job);
+
+    size_t rows = 0;
+    for (int c = 0; c < job.chunk_count; c++)
+    {
+        job.chunks[c].first_row = rows;
+        rows += job.chunks[c].rows;
+    }
+
+    job.pixels = rows ? malloc(rows * INPUT_SIZE * sizeof(float)) : NULL;
+    job.labels = rows ? malloc(rows * sizeof(int)) : NULL;
+    if (!job.pixels || !job.labels)
+    {
+        if (rows)
+            perror("Memory allocation failed");
+        free(job.pixels);
+        free(job.labels);
+        free(job.chunks);
+        thread_pool_free(pool);
+        munmap((void *)text, size);
+        return 0;
+    }
+
+    atomic_store(&job.next, 0);
+    thread_pool_run(pool, parse_chunk_rows, &job);
+
+    free(job.chunks);
+    thread_pool_free(pool);
+    munmap((void *)text, size);
+
+    size_t count = 0;
+    for (size_t row = 0; row < rows; row++)
+    {
+        if (job.labels[row] < 0)
+        {
+            fprintf(stderr, "[WARN] Skipping malformed sample %zu in %s\n", row + 1, filename);
+            continue;
+        }
+        if (count != row)
+        {
+            memcpy(job.pixels + count * INPUT_SIZE, job.pixels + row * INPUT_SIZE, INPUT_SIZE * sizeof(float));
+            job.labels[count] = job.labels[row];
+        }
+        count++;
+    }
+
+    if (count == 0)
+    {
+        free(job.pixels);
+        free(job.labels);
+        return 0;
+    }
+
+    double elapsed = now_seconds() - start;
+    printf("Parsed %s: %.1f MB in %.1f ms (%.1f MB/s, %d threads)\n",
+           filename, size / 1e6, elapsed * 1e3, size / 1e6 / elapsed, threads);
+
+    *out_pixels = job.pixels;
+    *out_labels = job.labels;
+    *out_count = (int)count;
+    return 1;
+}
+
+static int attach_samples(DatasetStore *store, float *pixels, const int32_t *labels)
+{
+    store->samples = malloc(store->count * sizeof(Dataset));
+    if (!store->samples)
+    {
+        perror("Memory allocation failed");
+        return 0;
+    }
+
+    for (int i = 0; i < store->count; i++)
+    {
+        if (labels[i] < 0 || labels[i] >= OUTPUT_SIZE)
+        {
+            fprintf(stderr, "[ERROR] Sample %d has label %d outside [0, %d)\n", i, (int)labels[i], OUTPUT_SIZE);
+            return 0;
+        }
+        store->samples[i].image = pixels + (size_t)i * INPUT_SIZE;
+        store->samples[i].label = labels[i];
+    }
+    return 1;
+}
+
+static int load_binary(int fd, const char *filename, DatasetStore *store)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(DatasetHeader))
+    {
+        fprintf(stderr, "[ERROR] %s is too small to be a dataset\n", filename);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Error mapping dataset");
+        return 0;
+    }
+    store->mapping = map;
+    store->mapping_size = size;
+
+    const DatasetHeader *header = map;
+    size_t pixel_size = header->pixel_type == DATASET_PIXEL_U8 ? sizeof(uint8_t) : sizeof(float);
+    size_t pixel_bytes = (size_t)header->sample_count * header->feature_count * pixel_size;
+    size_t label_bytes = (size_t)header->sample_count * sizeof(int32_t);
+
+    if (header->version != DATASET_VERSION ||
+        header->feature_count != INPUT_SIZE ||
+        header->sample_count == 0 ||
+        header->pixel_type > DATASET_PIXEL_U8 ||
+        header->pixel_offset % DATASET_ALIGNMENT != 0 ||
+        header->label_offset % sizeof(int32_t) != 0 ||
+        header->pixel_offset + pixel_bytes > size ||
+        header->label_offset + label_bytes > size)
+    {
+        fprintf(stderr, "[ERROR] %s has an invalid or unsupported dataset header\n", filename);
+        return 0;
+    }
+
+    madvise(map, size, MADV_WILLNEED);
+    store->count = header->sample_count;
+
+    const char *base = map;
+    const int32_t *labels = (const int32_t *)(base + header->label_offset);
+
+    if (header->pixel_type == DATASET_PIXEL_F32)
+        return attach_samples(store, (float *)(base + header->pixel_offset), labels);
+
+    size_t total = (size_t)store->count * INPUT_SIZE;
+    const uint8_t *quantized = (const uint8_t *)(base + header->pixel_offset);
+    store->pixels = malloc(total * sizeof(float));
+    if (!store->pixels)
+    {
+        perror("Memory allocation failed");
+        return 0;
+    }
+    for (size_t i = 0; i < total; i++)
+        store->pixels[i] = quantized[i] * (1.0f / 255.0f);
+
+    return attach_samples(store, store->pixels, labels);
+}
+
+static int load_csv(const char *filename, DatasetStore *store)
+{
+    int *labels = NULL;
+    if (!read_csv(filename, &store->pixels, &labels, &store->count))
+        return 0;
+
+    int ok = attach_samples(store, store->pixels, labels);
+    free(labels);
+    return ok;
+}
+
+int load_dataset(const char *filename, DatasetStore *store)
+{
+    memset(store, 0, sizeof(DatasetStore));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("Error opening file");
+        return 0;
+    }
+
+    char magic[4];
+    int is_binary = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+                    memcmp(magic, DATASET_MAGIC, sizeof(magic)) == 0;
+
+    int ok = is_binary ? load_binary(fd, filename, store) : load_csv(filename, store);
+    close(fd);
+
+    if (!ok)
+        close_dataset(store);
+    return ok;
+}
+
+void close_dataset(DatasetStore *store)
+{
+    if (!store)
+        return;
+
+    free(store->samples);
+    free(store->pixels);
+    if (store->mapping)
+        munmap(store->mapping, store->mapping_size);
+    memset(store, 0, sizeof(DatasetStore));
+}
+
+static int write_padding(FILE *file, size_t offset)
+{
+    static const char zeros[DATASET_ALIGNMENT] = {0};
+    size_t pad = DATASET_ALIGN_UP(offset) - offset;
+    return fwrite(zeros, 1, pad, file) == pad;
+}
+
+int convert_dataset(const char *csv_path, const char *bin_path, DatasetPixelType pixel_type)
+{
+    float *pixels = NULL;
+    int *labels = NULL;
+    int count = 0;
+    if (!read_csv(csv_path, &pixels, &labels, &count))
+        return 0;
+
+    size_t total = (size_t)count * INPUT_SIZE;
+    size_t pixel_size = pixel_type == DATASET_PIXEL_U8 ? sizeof(uint8_t) : sizeof(float);
+
+    DatasetHeader header = {0};
+    memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.version = DATASET_VERSION;
+    header.sample_count = count;
+    header.feature_count = INPUT_SIZE;
+    header.pixel_type = pixel_type;
+    header.pixel_offset = DATASET_ALIGN_UP(sizeof(DatasetHeader));
+    header.label_offset = DATASET_ALIGN_UP(header.pixel_offset + total * pixel_size);
+
+    FILE *file = fopen(bin_path, "wb");
+    if (!file)
+    {
+        perror("Error creating dataset file");
+        free(pixels);
+        free(labels);
+        return 0;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             write_padding(file, sizeof(header));
+
+    if (ok && pixel_type == DATASET_PIXEL_U8)
+    {
+        uint8_t *quantized = malloc(total);
+        ok = quantized != NULL;
+        for (size_t i = 0; ok && i < total; i++)
+        {
+            float scaled = pixels[i] * 255.0f;
+            quantized[i] = scaled <= 0.0f ? 0 : scaled >= 255.0f ? 255 : (uint8_t)lrintf(scaled);
+        }
+        ok = ok && fwrite(quantized, 1, total, file) == total;
+        free(quantized);
+    }
+    else if (ok)
+    {
+        ok = fwrite(pixels, sizeof(float), total, file) == total;
+    }
+
+    ok = ok && write_padding(file, header.pixel_offset + total * pixel_size);
+    for (int i = 0; ok && i < count; i++)
+    {
+        int32_t label = labels[i];
+        ok = fwrite(&label, sizeof(label), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0)
+        ok = 0;
+    if (!ok)
+        perror("Error writing dataset file");
+
+    free(pixels);
+    free(labels);
+    return ok;
+}
+
+SplitDataset split_dataset(Dataset *data, int total_count)
+{
+    int train_target_per_class[OUTPUT_SIZE] = {0};
+    int train_counts[OUTPUT_SIZE] = {0};
+    int label_counts[OUTPUT_SIZE] = {0};
+
+    for (int i = 0; i < total_count; i++)
+    {
+        label_counts[data[i].label]++;
+    }
+
+    for (int i = 0; i < OUTPUT_SIZE; i++)
+    {
+        train_target_per_class[i] = label_counts[i] / 1.5;
+    }
+
+    Dataset *train = malloc(sizeof(Dataset) * total_count);
+    Dataset *test = malloc(sizeof(Dataset) * total_count);
+    if (!train || !test)
+    {
+        perror("Memory allocation failed for split datasets");
+        free(train);
+        free(test);
+        exit(EXIT_FAILURE);
+    }
+
+    int train_idx = 0;
+    int test_idx = 0;
+
+    for (int i = 0; i < total_count; i++)
+    {
+        int label = data[i].label;
+
+        if (train_counts[label] < train_target_per_class[label])
+        {
+            train[train_idx++] = data[i];
+            train_counts[label]++;
+        }
+        else
+        {
+            test[test_idx++] = data[i];
+        }
+    }
+
+    return (SplitDataset){train, test, train_idx, test_idx};
+}
+
+void free_split_dataset(SplitDataset *split)
+{
+    free(split->train);
+    free(split->test);
+    split->train = split->test = NULL;
+    split->train_count = split->test_count = 0;
+}
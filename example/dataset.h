@@ -0,0 +1,63 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INPUT_SIZE 1024
+#define OUTPUT_SIZE 10
+
+#define DATASET_MAGIC "GGDS"
+#define DATASET_VERSION 1
+#define DATASET_ALIGNMENT 64
+
+typedef enum
+{
+    DATASET_PIXEL_F32 = 0,
+    DATASET_PIXEL_U8 = 1
+} DatasetPixelType;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t sample_count;
+    uint32_t feature_count;
+    uint32_t pixel_type;
+    uint32_t reserved;
+    uint64_t pixel_offset;
+    uint64_t label_offset;
+} DatasetHeader;
+
+typedef struct
+{
+    float *image;
+    int label;
+} Dataset;
+
+typedef struct
+{
+    Dataset *samples;
+    int count;
+
+    float *pixels;
+    void *mapping;
+    size_t mapping_size;
+} DatasetStore;
+
+typedef struct
+{
+    Dataset *train;
+    Dataset *test;
+    int train_count;
+    int test_count;
+} SplitDataset;
+
+int load_dataset(const char *filename, DatasetStore *store);
+void close_dataset(DatasetStore *store);
+int convert_dataset(const char *csv_path, const char *bin_path, DatasetPixelType pixel_type);
+
+SplitDataset split_dataset(Dataset *data, int total_count);
+void free_split_dataset(SplitDataset *split);
+
+#endif
@@ -7,13 +7,20 @@
 
 #include "../include/value.h"
 #include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/batch.h"
+#include "../include/graph.h"
+#include "../include/optim.h"
+#include "../include/serialize.h"
+#include "dataset.h"
 
-#define INPUT_SIZE 1024
-#define OUTPUT_SIZE 10
 #define LEARNING_RATE 0.001
 #define EPOCHS 10
 #define BATCH_SIZE 32
+#define WEIGHT_COUNT (INPUT_SIZE * OUTPUT_SIZE)
+#define PARAM_COUNT (WEIGHT_COUNT + OUTPUT_SIZE)
 #define M_PI 3.14159265358979323846
+#define MODEL_PATH "output/digit.model"
 
 double he_init(int fan_in)
 {
@@ -25,361 +32,264 @@ double he_init(int fan_in)
 
 typedef struct
 {
-    float *image;
-    int label;
-} Dataset;
+    Value *input[INPUT_SIZE];
+    Graph *graph;
+} CompiledStep;
 
 typedef struct
 {
-    Dataset *train;
-    Dataset *test;
-    int train_count;
-    int test_count;
-} SplitDataset;
-
-Dataset *create_dataset(const char *filename, int *out_sample_count);
-void free_dataset(Dataset *data, int sample_count);
+    Dataset *data;
+    CompiledStep *steps;
+    double *loss;
+    int *correct;
+} TrainContext;
+
 int argmax(double *array, int length);
-SplitDataset split_dataset(Dataset *data, int total_count);
-void evaluate_model(Value **weights, Value **biases, Dataset *data, int count);
-Value *cross_entropy_loss(Value **softmax_outputs, int label, int n);
+Value *build_network(Value **input, Value **weights, Value **biases, int label, Value **logits);
+Value *build_model(Value **weights, Value **biases, Dataset *sample, int *predicted);
+int capture_step(CompiledStep *step, Value **params, int label);
+int train_sample(void *user, int worker, int sample, Value **params);
+void export_graphs(Value **weights, Value **biases, Dataset *sample, Tape *tape);
+void evaluate_model(Value **weights, Value **biases, Dataset *data, int count, Tape *tape);
 
-void value_free_safe(Value **value_ptr)
+int argmax(double *array, int length)
 {
-    if (value_ptr && *value_ptr)
+    int max_index = 0;
+    for (int i = 1; i < length; i++)
     {
-        Value *v = *value_ptr;
-        if (v->prev)
-        {
-            v->prev_count = 0;
-            free(v->prev);
-            v->prev = NULL;
-        }
-        if (v->backward_ctx)
+        if (array[i] > array[max_index])
         {
-            free(v->backward_ctx);
-            v->backward_ctx = NULL;
+            max_index = i;
         }
-        free(v);
-        *value_ptr = NULL;
     }
+    return max_index;
 }
 
-Dataset *create_dataset(const char *filename, int *out_sample_count)
+Value *build_network(Value **input, Value **weights, Value **biases, int label, Value **logits)
 {
-    FILE *file = fopen(filename, "r");
-    if (!file)
+    for (int i = 0; i < OUTPUT_SIZE; i++)
     {
-        perror("Error opening file");
-        return NULL;
+        Value *sum = value_dot(input, &weights[i * INPUT_SIZE], INPUT_SIZE);
+        logits[i] = value_add(sum, biases[i]);
     }
 
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    int line_count = 0;
+    return value_softmax_cross_entropy(logits, label, OUTPUT_SIZE);
+}
 
-    while ((read = getline(&line, &len, file)) != -1)
-    {
-        line_count++;
-    }
+Value *build_model(Value **weights, Value **biases, Dataset *sample, int *predicted)
+{
+    Value *input[INPUT_SIZE];
+    for (int i = 0; i < INPUT_SIZE; i++)
+        input[i] = value_create(sample->image[i]);
 
-    if (line_count <= 1)
-    {
-        free(line);
-        fclose(file);
-        return NULL;
-    }
+    Value *out[OUTPUT_SIZE];
+    Value *loss = build_network(input, weights, biases, sample->label, out);
 
-    rewind(file);
-    getline(&line, &len, file);
-    int sample_count = line_count - 1;
-    Dataset *data = malloc(sample_count * sizeof(Dataset));
-    if (!data)
+    double logits[OUTPUT_SIZE];
+    for (int i = 0; i < OUTPUT_SIZE; i++)
     {
-        perror("Memory allocation failed");
-        free(line);
-        fclose(file);
-        return NULL;
+        logits[i] = out[i]->data;
     }
+    *predicted = argmax(logits, OUTPUT_SIZE);
 
-    int current_sample = 0;
-    while ((read = getline(&line, &len, file)) != -1 && current_sample < sample_count)
-    {
-        line[strcspn(line, "\n")] = 0;
-        int col_count = 0;
-
-        char *temp = strdup(line);
-        char *token = strtok(temp, ",");
-        while (token)
-        {
-            col_count++;
-            token = strtok(NULL, ",");
-        }
-        free(temp);
-
-        if (col_count < 2)
-            continue;
-
-        int feature_count = col_count - 1;
-        data[current_sample].image = malloc(feature_count * sizeof(float));
-        if (!data[current_sample].image)
-        {
-            perror("Memory allocation failed for image");
-            free_dataset(data, current_sample);
-            free(line);
-            fclose(file);
-            return NULL;
-        }
-
-        token = strtok(line, ",");
-        for (int i = 0; i < feature_count && token != NULL; i++)
-        {
-            if (i == 0)
-            {
-                data[current_sample].label = atoi(token);
-            }
-            else
-            {
-                data[current_sample].image[i - 1] = strtof(token, NULL);
-            }
-            token = strtok(NULL, ",");
-        }
-
-        current_sample++;
-    }
-
-    free(line);
-    fclose(file);
-
-    *out_sample_count = current_sample;
-    return data;
+    return loss;
 }
 
-void free_dataset(Dataset *data, int sample_count)
+int capture_step(CompiledStep *step, Value **params, int label)
 {
-    for (int i = 0; i < sample_count; i++)
-    {
-        free(data[i].image);
-    }
-    free(data);
+    Value *logits[OUTPUT_SIZE];
+    Value *loss = build_network(step->input, params, params + WEIGHT_COUNT, label, logits);
+    if (!loss)
+        return 0;
+
+    Value **leaves = malloc((INPUT_SIZE + PARAM_COUNT) * sizeof(Value *));
+    if (!leaves)
+        return 0;
+    memcpy(leaves, step->input, INPUT_SIZE * sizeof(Value *));
+    memcpy(leaves + INPUT_SIZE, params, PARAM_COUNT * sizeof(Value *));
+
+    step->graph = graph_capture(loss, leaves, INPUT_SIZE + PARAM_COUNT, logits, OUTPUT_SIZE);
+    free(leaves);
+    return step->graph != NULL;
 }
 
-int argmax(double *array, int length)
+int train_sample(void *user, int worker, int sample, Value **params)
 {
-    int max_index = 0;
-    for (int i = 1; i < length; i++)
-    {
-        if (array[i] > array[max_index])
-        {
-            max_index = i;
-        }
-    }
-    return max_index;
-}
+    TrainContext *ctx = user;
+    CompiledStep *step = &ctx->steps[worker];
+    Dataset *data = &ctx->data[sample];
 
-SplitDataset split_dataset(Dataset *data, int total_count)
-{
-    int train_target_per_class[OUTPUT_SIZE] = {0};
-    int train_counts[OUTPUT_SIZE] = {0};
-    int label_counts[OUTPUT_SIZE] = {0};
+    for (int i = 0; i < INPUT_SIZE; i++)
+        step->input[i]->data = data->image[i];
 
-    for (int i = 0; i < total_count; i++)
-    {
-        label_counts[data[i].label]++;
-    }
+    if (!step->graph && !capture_step(step, params, data->label))
+        return 0;
+    if (!graph_set_label(step->graph, data->label))
+        return 0;
 
+    /* The replay writes the parameter grads itself, hence run_grads. */
+    double loss = graph_forward(step->graph);
+    graph_backward(step->graph);
+
+    double logits[OUTPUT_SIZE];
     for (int i = 0; i < OUTPUT_SIZE; i++)
-    {
-        train_target_per_class[i] = label_counts[i] / 1.5;
-    }
+        logits[i] = graph_output(step->graph, i);
 
-    Dataset *train = malloc(sizeof(Dataset) * total_count);
-    Dataset *test = malloc(sizeof(Dataset) * total_count);
-    if (!train || !test)
-    {
-        perror("Memory allocation failed for split datasets");
-        free(train);
-        free(test);
-        exit(EXIT_FAILURE);
-    }
+    ctx->loss[worker] += loss;
+    if (argmax(logits, OUTPUT_SIZE) == data->label)
+        ctx->correct[worker]++;
+
+    return 1;
+}
 
-    int train_idx = 0;
-    int test_idx = 0;
+void export_graphs(Value **weights, Value **biases, Dataset *sample, Tape *tape)
+{
+    int predicted;
 
-    for (int i = 0; i < total_count; i++)
+    tape_begin(tape);
+    Value *loss = build_model(weights, biases, sample, &predicted);
+    if (loss)
     {
-        int label = data[i].label;
-        Dataset *target_dataset;
-        int *target_idx;
+        value_print_forward_graph(loss, "digit_forward.dot");
 
-        if (train_counts[label] < train_target_per_class[label])
-        {
-            target_dataset = train;
-            target_idx = &train_idx;
-            train_counts[label]++;
-        }
-        else
-        {
-            target_dataset = test;
-            target_idx = &test_idx;
-        }
+        value_backward(loss);
 
-        int feature_count = INPUT_SIZE;
-        target_dataset[*target_idx].image = malloc(sizeof(float) * feature_count);
-        if (!target_dataset[*target_idx].image)
-        {
-            perror("Memory allocation failed for dataset image");
-            free_dataset(train, train_idx);
-            free_dataset(test, test_idx);
-            exit(EXIT_FAILURE);
-        }
-        memcpy(target_dataset[*target_idx].image, data[i].image, sizeof(float) * feature_count);
-        target_dataset[*target_idx].label = label;
-        (*target_idx)++;
-    }
+        value_print_backward_graph(loss, "digit_backward.dot");
+        value_print_full_graph(loss, "digit_full.dot");
 
-    return (SplitDataset){train, test, train_idx, test_idx};
+        printf("\nComputation graphs generated for neural network:\n");
+        printf("Forward graph: output/digit_forward.dot\n");
+        printf("Backward graph: output/digit_backward.dot\n");
+        printf("Full graph: output/digit_full.dot\n");
+        printf("\nTo visualize, run:\n");
+        printf("dot -Tsvg output/digit_*.dot -o digit_*.svg\n\n");
+    }
+    tape_end();
+    tape_reset(tape);
 }
 
 void evaluate_model(Value **weights, Value **biases,
-                    Dataset *data, int count)
+                    Dataset *data, int count, Tape *tape)
 {
     int correct = 0;
     double total_loss = 0.0;
 
+    value_no_grad_begin();
     for (int i = 0; i < count; i++)
     {
-        Value *input[INPUT_SIZE];
-        for (int j = 0; j < INPUT_SIZE; j++)
-            input[j] = value_create(data[i].image[j]);
-
-        Value *out[OUTPUT_SIZE];
-        for (int j = 0; j < OUTPUT_SIZE; j++)
-        {
-            Value *sum = value_create(0.0);
-            for (int k = 0; k < INPUT_SIZE; k++)
-            {
-                Value *prod = value_mul(input[k], weights[k + j * INPUT_SIZE]);
-                Value *new_sum = value_add(sum, prod);
-                value_free_safe(&sum);
-                value_free_safe(&prod);
-                sum = new_sum;
-            }
-            out[j] = value_add(sum, biases[j]);
-            value_free_safe(&sum);
-        }
+        int predicted;
 
-        Value **softmax_output = value_softmax(out, OUTPUT_SIZE);
-        Value *loss = cross_entropy_loss(softmax_output, data[i].label, OUTPUT_SIZE);
-        total_loss += loss->data;
-
-        double probs[OUTPUT_SIZE];
-        for (int j = 0; j < OUTPUT_SIZE; j++)
+        tape_begin(tape);
+        Value *loss = build_model(weights, biases, &data[i], &predicted);
+        if (loss)
         {
-            probs[j] = softmax_output[j]->data;
+            total_loss += loss->data;
+            if (predicted == data[i].label)
+                correct++;
         }
-        int predicted = argmax(probs, OUTPUT_SIZE);
-        if (predicted == data[i].label)
-            correct++;
-
-        for (int j = 0; j < INPUT_SIZE; j++)
-            value_free_safe(&input[j]);
-        for (int j = 0; j < OUTPUT_SIZE; j++)
-            value_free_safe(&softmax_output[j]);
-        free(softmax_output);
-        for (int j = 0; j < OUTPUT_SIZE; j++)
-            value_free_safe(&out[j]);
-        value_free_safe(&loss);
+        tape_end();
+        tape_reset(tape);
     }
+    value_no_grad_end();
 
     printf("Evaluation: Loss: %.4f | Accuracy: %.2f%%\n",
            total_loss / count, (double)correct / count * 100.0);
 }
 
-void backward_cross_entropy(Value *self)
+int main(int argc, char **argv)
 {
-    int n = self->prev_count;
-    int label = *(int *)self->backward_ctx;
-
-    for (int i = 0; i < n; i++)
+    const char *file_path = access("data.bin", R_OK) == 0 ? "data.bin" : "data.csv";
+    DatasetStore store;
+    if (!load_dataset(file_path, &store))
     {
-        double indicator = (i == label) ? 1.0 : 0.0;
-        self->prev[i]->grad = self->grad * (self->prev[i]->data - indicator);
+        printf("Failed to create dataset\n");
+        return 1;
     }
-}
 
-Value *cross_entropy_loss(Value **softmax_outputs, int label, int n)
-{
-    const double epsilon = 1e-7;
-    Value *neg_log_prob = value_create(-log(softmax_outputs[label]->data + epsilon));
-    if (!neg_log_prob)
+    SplitDataset split = split_dataset(store.samples, store.count);
+    if (split.train_count == 0 || split.test_count == 0)
     {
-        return NULL;
+        printf("Insufficient data for training or testing\n");
+        free_split_dataset(&split);
+        close_dataset(&store);
+        return 1;
     }
 
-    neg_log_prob->prev = malloc(n * sizeof(Value *));
-    if (!neg_log_prob->prev)
-    {
-        value_free(neg_log_prob);
-        return NULL;
-    }
+    printf("Split dataset: %d training samples, %d test samples\n",
+           split.train_count, split.test_count);
 
-    int *label_ptr = malloc(sizeof(int));
-    if (!label_ptr)
-    {
-        free(neg_log_prob->prev);
-        value_free(neg_log_prob);
-        return NULL;
-    }
+    Value *params[PARAM_COUNT];
+    Value **weights = params;
+    Value **biases = params + WEIGHT_COUNT;
 
-    *label_ptr = label;
+    for (int i = 0; i < WEIGHT_COUNT; i++)
+        weights[i] = value_create(he_init(INPUT_SIZE));
+    for (int i = 0; i < OUTPUT_SIZE; i++)
+        biases[i] = value_create(0.0);
 
-    for (int i = 0; i < n; i++)
+    Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    BatchRunner *runner = batch_runner_create(params, PARAM_COUNT, 0);
+    Optimizer *opt = optim_create(0);
+    /* The runner averages over the batch. Scaling the rate by the batch
+       size keeps the per-batch step bound of BATCH_SIZE clipped per-sample
+       updates at LEARNING_RATE. */
+    OptimConfig config = optim_sgd(LEARNING_RATE * BATCH_SIZE, 0.0);
+    config.clip = 1.0;
+    if (!tape || !runner || !opt || optim_add_values(opt, params, PARAM_COUNT, config) < 0)
     {
-        neg_log_prob->prev[i] = softmax_outputs[i];
+        printf("Failed to create training state\n");
+        return 1;
     }
-    neg_log_prob->prev_count = n;
-    neg_log_prob->backward = backward_cross_entropy;
-    neg_log_prob->backward_ctx = label_ptr;
-
-    return neg_log_prob;
-}
 
-int main()
-{
-    const char *file_path = "data.csv";
-    int sample_count;
-    Dataset *full_data = create_dataset(file_path, &sample_count);
-    if (!full_data)
+    /* The parameters and optimizer state are saved after every epoch;
+       --resume picks the run up from the last saved epoch. */
+    ModelWriter *writer = model_writer_create();
+    if (!writer || !model_writer_add_values(writer, "params", params, PARAM_COUNT) ||
+        !model_writer_add_optim(writer, "optim", opt))
     {
-        printf("Failed to create dataset\n");
+        printf("Failed to create model writer\n");
         return 1;
     }
 
-    SplitDataset split = split_dataset(full_data, sample_count);
-    if (split.train_count == 0 || split.test_count == 0)
+    int first_epoch = 0;
+    unsigned long long step = 0;
+    if (argc > 1 && strcmp(argv[1], "--resume") == 0)
     {
-        printf("Insufficient data for training or testing\n");
-        free_dataset(full_data, sample_count);
-        return 1;
+        ModelFile *model = model_open(MODEL_PATH);
+        if (!model || !model_load_values(model, "params", params, PARAM_COUNT) ||
+            !model_load_optim(model, "optim", opt))
+        {
+            printf("Failed to resume from %s\n", MODEL_PATH);
+            return 1;
+        }
+        first_epoch = (int)model_epoch(model);
+        step = model_step(model);
+        model_close(model);
+        printf("Resumed from %s after epoch %d\n", MODEL_PATH, first_epoch);
     }
 
-    printf("Split dataset: %d training samples, %d test samples\n",
-           split.train_count, split.test_count);
-
-    Value *weights[INPUT_SIZE * OUTPUT_SIZE];
-    Value *biases[OUTPUT_SIZE];
+    int num_workers = batch_runner_threads(runner);
+    double worker_loss[num_workers];
+    int worker_correct[num_workers];
+    CompiledStep steps[num_workers];
+    for (int w = 0; w < num_workers; w++)
+    {
+        for (int i = 0; i < INPUT_SIZE; i++)
+            steps[w].input[i] = value_create(0.0);
+        steps[w].graph = NULL;
+    }
+    TrainContext ctx = {split.train, steps, worker_loss, worker_correct};
 
-    for (int i = 0; i < INPUT_SIZE * OUTPUT_SIZE; i++)
-        weights[i] = value_create(he_init(INPUT_SIZE));
-    for (int i = 0; i < OUTPUT_SIZE; i++)
-        biases[i] = value_create(0.0);
+    printf("Training with %d worker thread(s)\n", num_workers);
+    export_graphs(weights, biases, &split.train[0], tape);
 
-    for (int epoch = 0; epoch < EPOCHS; epoch++)
+    for (int epoch = first_epoch; epoch < EPOCHS; epoch++)
     {
-        double epoch_loss = 0.0;
-        int correct = 0;
+        for (int w = 0; w < num_workers; w++)
+        {
+            worker_loss[w] = 0.0;
+            worker_correct[w] = 0;
+        }
 
         for (int batch_start = 0; batch_start < split.train_count; batch_start += BATCH_SIZE)
         {
@@ -387,115 +297,49 @@ int main()
             if (batch_end > split.train_count)
                 batch_end = split.train_count;
 
-            for (int sample_index = batch_start; sample_index < batch_end; sample_index++)
+            if (!batch_runner_run_grads(runner, batch_start, batch_end, train_sample, &ctx))
             {
-
-                for (int i = 0; i < INPUT_SIZE * OUTPUT_SIZE; i++)
-                    value_zero_grad(weights[i]);
-                for (int i = 0; i < OUTPUT_SIZE; i++)
-                    value_zero_grad(biases[i]);
-
-                Value *input[INPUT_SIZE];
-                for (int i = 0; i < INPUT_SIZE; i++)
-                    input[i] = value_create(split.train[sample_index].image[i]);
-
-                Value *out[OUTPUT_SIZE];
-                for (int i = 0; i < OUTPUT_SIZE; i++)
-                {
-                    Value *sum = value_create(0.0);
-                    for (int j = 0; j < INPUT_SIZE; j++)
-                    {
-                        Value *prod = value_mul(input[j], weights[j + i * INPUT_SIZE]);
-                        Value *new_sum = value_add(sum, prod);
-                        value_free_safe(&sum);
-                        value_free_safe(&prod);
-                        sum = new_sum;
-                    }
-                    out[i] = value_add(sum, biases[i]);
-                    value_free_safe(&sum);
-                }
-
-                Value **softmax_output = value_softmax(out, OUTPUT_SIZE);
-                Value *loss = cross_entropy_loss(softmax_output, split.train[sample_index].label, OUTPUT_SIZE);
-
-                if (epoch == 0 && sample_index == 0)
-                {
-                    value_print_forward_graph(loss, "digit_forward.dot");
-
-                    value_backward(loss);
-
-                    value_print_backward_graph(loss, "digit_backward.dot");
-                    value_print_full_graph(loss, "digit_full.dot");
-
-                    printf("\nComputation graphs generated for neural network:\n");
-                    printf("Forward graph: output/digit_forward.dot\n");
-                    printf("Backward graph: output/digit_backward.dot\n");
-                    printf("Full graph: output/digit_full.dot\n");
-                    printf("\nTo visualize, run:\n");
-                    printf("dot -Tsvg output/digit_*.dot -o digit_*.svg\n\n");
-                }
-                else
-                {
-                    value_backward(loss);
-                }
-
-                epoch_loss += loss->data;
-
-                double probs[OUTPUT_SIZE];
-                for (int i = 0; i < OUTPUT_SIZE; i++)
-                {
-                    probs[i] = softmax_output[i]->data;
-                }
-                int predicted = argmax(probs, OUTPUT_SIZE);
-                if (predicted == split.train[sample_index].label)
-                    correct++;
-
-                double clip_threshold = 1.0;
-                for (int i = 0; i < INPUT_SIZE * OUTPUT_SIZE; i++)
-                {
-                    double grad = weights[i]->grad;
-                    if (grad > clip_threshold)
-                        grad = clip_threshold;
-                    if (grad < -clip_threshold)
-                        grad = -clip_threshold;
-                    weights[i]->data -= LEARNING_RATE * grad;
-                }
-                for (int i = 0; i < OUTPUT_SIZE; i++)
-                {
-                    double grad = biases[i]->grad;
-                    if (grad > clip_threshold)
-                        grad = clip_threshold;
-                    if (grad < -clip_threshold)
-                        grad = -clip_threshold;
-                    biases[i]->data -= LEARNING_RATE * grad;
-                }
-
-                for (int i = 0; i < INPUT_SIZE; i++)
-                    value_free_safe(&input[i]);
-                for (int i = 0; i < OUTPUT_SIZE; i++)
-                    value_free_safe(&softmax_output[i]);
-                free(softmax_output);
-                for (int i = 0; i < OUTPUT_SIZE; i++)
-                    value_free_safe(&out[i]);
-                value_free_safe(&loss);
+                printf("Failed to build batch graph\n");
+                return 1;
             }
+
+            optim_step(opt);
+            step++;
+        }
+
+        double epoch_loss = 0.0;
+        int correct = 0;
+        for (int w = 0; w < num_workers; w++)
+        {
+            epoch_loss += worker_loss[w];
+            correct += worker_correct[w];
         }
 
         printf("Epoch %d | Train Loss: %.4f | Train Accuracy: %.2f%%\n", epoch + 1,
                epoch_loss / split.train_count, (double)correct / split.train_count * 100.0);
+
+        if (!model_writer_save(writer, MODEL_PATH, epoch + 1, step))
+            printf("Failed to save %s\n", MODEL_PATH);
     }
+    model_writer_free(writer);
 
     evaluate_model(weights, biases,
-                   split.test, split.test_count);
+                   split.test, split.test_count, tape);
 
-    for (int i = 0; i < INPUT_SIZE * OUTPUT_SIZE; i++)
-        value_free_safe(&weights[i]);
-    for (int i = 0; i < OUTPUT_SIZE; i++)
-        value_free_safe(&biases[i]);
-
-    free_dataset(split.train, split.train_count);
-    free_dataset(split.test, split.test_count);
-    free_dataset(full_data, sample_count);
+    for (int w = 0; w < num_workers; w++)
+    {
+        for (int i = 0; i < INPUT_SIZE; i++)
+            value_free(steps[w].input[i]);
+        graph_free(steps[w].graph);
+    }
+    for (int i = 0; i < PARAM_COUNT; i++)
+        value_free(params[i]);
+    optim_free(opt);
+    batch_runner_free(runner);
+    tape_free(tape);
+
+    free_split_dataset(&split);
+    close_dataset(&store);
 
     return 0;
 }
\ No newline at end of file
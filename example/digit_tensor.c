@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../include/value.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/tensor.h"
+#include "../include/optim.h"
+#include "../include/profile.h"
+#include "../include/serialize.h"
+#include "dataset.h"
+
+#define LEARNING_RATE 0.05
+#define EPOCHS 10
+#define BATCH_SIZE 32
+#define M_PI 3.14159265358979323846
+#define MODEL_PATH "output/digit_tensor.model"
+
+double he_init(int fan_in)
+{
+    double u1 = (double)rand() / RAND_MAX;
+    double u2 = (double)rand() / RAND_MAX;
+    double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    return normal * sqrt(2.0 / fan_in);
+}
+
+Tensor *forward_batch(Tensor *weights, Tensor *biases, Dataset *data, int count);
+int count_correct(Tensor *probs, Dataset *data);
+void evaluate_model(Tensor *weights, Tensor *biases, Dataset *data, int count, Tape *tape);
+int infer_from_model(SplitDataset *split);
+
+Tensor *forward_batch(Tensor *weights, Tensor *biases, Dataset *data, int count)
+{
+    size_t shape[2] = {count, INPUT_SIZE};
+    Tensor *input = tensor_create(shape, 2);
+    if (!input)
+        return NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < INPUT_SIZE; j++)
+            input->data[i * INPUT_SIZE + j] = data[i].image[j];
+    }
+
+    Tensor *logits = tensor_matmul(input, tensor_transpose(weights));
+    if (!logits)
+        return NULL;
+    return tensor_softmax(tensor_add(logits, biases));
+}
+
+int count_correct(Tensor *probs, Dataset *data)
+{
+    int correct = 0;
+    for (size_t i = 0; i < probs->shape[0]; i++)
+    {
+        const real_t *row = probs->data + i * OUTPUT_SIZE;
+        int predicted = 0;
+        for (int j = 1; j < OUTPUT_SIZE; j++)
+        {
+            if (row[j] > row[predicted])
+                predicted = j;
+        }
+        if (predicted == data[i].label)
+            correct++;
+    }
+    return correct;
+}
+
+void evaluate_model(Tensor *weights, Tensor *biases,
+                    Dataset *data, int count, Tape *tape)
+{
+    int correct = 0;
+    double total_loss = 0.0;
+    int labels[BATCH_SIZE];
+
+    value_no_grad_begin();
+    for (int batch_start = 0; batch_start < count; batch_start += BATCH_SIZE)
+    {
+        int batch_count = count - batch_start < BATCH_SIZE ? count - batch_start : BATCH_SIZE;
+        for (int i = 0; i < batch_count; i++)
+            labels[i] = data[batch_start + i].label;
+
+        tape_begin(tape);
+        Tensor *probs = forward_batch(weights, biases, data + batch_start, batch_count);
+        Value *loss = tensor_cross_entropy(probs, labels);
+        if (loss)
+        {
+            total_loss += loss->data * batch_count;
+            correct += count_correct(probs, data + batch_start);
+        }
+        tape_end();
+        tape_reset(tape);
+    }
+    value_no_grad_end();
+
+    printf("Evaluation: Loss: %.4f | Accuracy: %.2f%%\n",
+           total_loss / count, (double)correct / count * 100.0);
+}
+
+/* Inference straight off the saved model: the weights are mapped, not read,
+   so start-up cost does not grow with the model size. */
+int infer_from_model(SplitDataset *split)
+{
+    ModelFile *model = model_open(MODEL_PATH);
+    Tensor *weights = model ? model_map_tensor(model, "weights") : NULL;
+    Tensor *biases = model ? model_map_tensor(model, "biases") : NULL;
+    Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    if (!weights || !biases || !tape)
+    {
+        printf("Failed to load %s (train once without --infer first)\n", MODEL_PATH);
+        return 1;
+    }
+
+    printf("Mapped %s (epoch %llu)\n", MODEL_PATH, (unsigned long long)model_epoch(model));
+    evaluate_model(weights, biases, split->test, split->test_count, tape);
+
+    tensor_free(weights);
+    tensor_free(biases);
+    model_close(model);
+    tape_free(tape);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *file_path = access("data.bin", R_OK) == 0 ? "data.bin" : "data.csv";
+    DatasetStore store;
+    if (!load_dataset(file_path, &store))
+    {
+        printf("Failed to create dataset\n");
+        return 1;
+    }
+
+    SplitDataset split = split_dataset(store.samples, store.count);
+    if (split.train_count == 0 || split.test_count == 0)
+    {
+        printf("Insufficient data for training or testing\n");
+        free_split_dataset(&split);
+        close_dataset(&store);
+        return 1;
+    }
+
+    printf("Split dataset: %d training samples, %d test samples\n",
+           split.train_count, split.test_count);
+    printf("Tensor precision: %s\n", REAL_NAME);
+
+    if (argc > 1 && strcmp(argv[1], "--infer") == 0)
+    {
+        int status = infer_from_model(&split);
+        free_split_dataset(&split);
+        close_dataset(&store);
+        return status;
+    }
+
+    size_t weight_shape[2] = {OUTPUT_SIZE, INPUT_SIZE};
+    size_t bias_shape[1] = {OUTPUT_SIZE};
+    Tensor *weights = tensor_create(weight_shape, 2);
+    Tensor *biases = tensor_create(bias_shape, 1);
+    Tape *tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+    Optimizer *opt = optim_create(1);
+    OptimConfig config = optim_sgd(LEARNING_RATE, 0.0);
+    config.clip = 1.0;
+    if (!weights || !biases || !tape || !opt ||
+        optim_add_tensor(opt, weights, config) < 0 || optim_add_tensor(opt, biases, config) < 0)
+    {
+        printf("Failed to allocate model\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < weights->size; i++)
+        weights->data[i] = he_init(INPUT_SIZE);
+
+    /* Profiling builds (make PROFILE=1) trace the first epoch only; the
+       per-op totals keep accumulating over the whole run. */
+    if (profile_enabled())
+        profile_trace_begin(0);
+
+    int labels[BATCH_SIZE];
+    unsigned long long step = 0;
+    for (int epoch = 0; epoch < EPOCHS; epoch++)
+    {
+        double epoch_loss = 0.0;
+        int correct = 0;
+
+        for (int batch_start = 0; batch_start < split.train_count; batch_start += BATCH_SIZE)
+        {
+            int batch_count = split.train_count - batch_start < BATCH_SIZE ? split.train_count - batch_start : BATCH_SIZE;
+            Dataset *batch = split.train + batch_start;
+            for (int i = 0; i < batch_count; i++)
+                labels[i] = batch[i].label;
+
+            profile_region_begin("step");
+            tape_begin(tape);
+
+            Tensor *probs = forward_batch(weights, biases, batch, batch_count);
+            Value *loss = tensor_cross_entropy(probs, labels);
+            if (!loss)
+            {
+                printf("Failed to build batch graph\n");
+                return 1;
+            }
+
+            value_backward(loss);
+
+            epoch_loss += loss->data * batch_count;
+            correct += count_correct(probs, batch);
+
+            profile_region_begin("optim_step");
+            optim_step(opt);
+            profile_region_end();
+            step++;
+
+            tape_end();
+            tape_reset(tape);
+            profile_region_end();
+        }
+        profile_trace_end();
+
+        printf("Epoch %d | Train Loss: %.4f | Train Accuracy: %.2f%%\n", epoch + 1,
+               epoch_loss / split.train_count, (double)correct / split.train_count * 100.0);
+    }
+
+    evaluate_model(weights, biases,
+                   split.test, split.test_count, tape);
+
+    mkdir("output", 0700);
+    ModelWriter *writer = model_writer_create();
+    if (writer && model_writer_add_tensor(writer, "weights", weights) &&
+        model_writer_add_tensor(writer, "biases", biases) && model_writer_add_optim(writer, "optim", opt) &&
+        model_writer_save(writer, MODEL_PATH, EPOCHS, step))
+        printf("Saved model to %s\n", MODEL_PATH);
+    model_writer_free(writer);
+
+    if (profile_enabled())
+    {
+        printf("\n");
+        profile_print(stdout);
+        if (profile_write_trace("digit_tensor_trace.json") && profile_write_folded("digit_tensor.folded"))
+            printf("Trace: output/digit_tensor_trace.json (chrome://tracing), stacks: output/digit_tensor.folded\n");
+    }
+
+    optim_free(opt);
+    tensor_free(weights);
+    tensor_free(biases);
+    tape_free(tape);
+
+    free_split_dataset(&split);
+    close_dataset(&store);
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "value.h"
+
+typedef struct BatchRunner BatchRunner;
+
+typedef Value *(*BatchSampleFn)(void *user, int worker, int sample, Value **params);
+typedef int (*BatchGradFn)(void *user, int worker, int sample, Value **params);
+
+BatchRunner *batch_runner_create(Value **params, size_t param_count, int num_threads);
+void batch_runner_free(BatchRunner *runner);
+
+int batch_runner_threads(BatchRunner *runner);
+int batch_runner_run(BatchRunner *runner, int begin, int end, BatchSampleFn fn, void *user);
+/* For callbacks that compute their own gradients (e.g. graph_backward):
+   fn writes the sample's gradient into params[i]->grad, which the runner
+   zeroes before every call, and returns 0 on failure. */
+int batch_runner_run_grads(BatchRunner *runner, int begin, int end, BatchGradFn fn, void *user);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include "value.h"
+
+typedef int (*CheckpointFn)(void *ctx, Value **inputs, size_t input_count,
+                            Value **outputs, size_t output_count);
+
+typedef struct
+{
+    size_t segments;
+    size_t recomputes;
+    size_t released_bytes;
+    size_t peak_scratch_bytes;
+} CheckpointStats;
+
+/* fn runs again during backward, so it must be deterministic and ctx must
+   stay alive until the backward pass has run. Activations reach fn through
+   inputs. Every other Value it reads (parameters, via ctx) must be listed
+   in params: they become prev of the segment, so backward zeroes them and
+   they receive their gradient from the recompute. */
+int value_checkpoint(CheckpointFn fn, void *ctx, Value **inputs, size_t input_count,
+                     Value **params, size_t param_count, Value **outputs, size_t output_count);
+
+void checkpoint_get_stats(CheckpointStats *stats);
+void checkpoint_reset_stats(void);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef DUAL_H
+#define DUAL_H
+
+#define DUAL_MAX_TANGENTS 8
+
+typedef struct
+{
+    double val;
+    double dot;
+} Dual;
+
+typedef struct
+{
+    double val;
+    double dot[DUAL_MAX_TANGENTS];
+} DualVec;
+
+Dual dual_make(double val, double dot);
+Dual dual_const(double val);
+
+Dual dual_add(Dual a, Dual b);
+Dual dual_sub(Dual a, Dual b);
+Dual dual_mul(Dual a, Dual b);
+Dual dual_div(Dual a, Dual b);
+Dual dual_pow(Dual base, double exponent);
+Dual dual_relu(Dual x);
+Dual dual_tanh(Dual x);
+Dual dual_sum(const Dual *xs, int n);
+Dual dual_dot(const Dual *a, const Dual *b, int n);
+
+void dualvec_const(DualVec *out, double val);
+void dualvec_seed(DualVec *out, double val, int tangent);
+
+void dualvec_add(DualVec *out, const DualVec *a, const DualVec *b);
+void dualvec_sub(DualVec *out, const DualVec *a, const DualVec *b);
+void dualvec_mul(DualVec *out, const DualVec *a, const DualVec *b);
+void dualvec_div(DualVec *out, const DualVec *a, const DualVec *b);
+void dualvec_pow(DualVec *out, const DualVec *base, double exponent);
+void dualvec_relu(DualVec *out, const DualVec *x);
+void dualvec_tanh(DualVec *out, const DualVec *x);
+void dualvec_sum(DualVec *out, const DualVec *xs, int n);
+void dualvec_dot(DualVec *out, const DualVec *a, const DualVec *b, int n);
+
+#endif
@@ -7,6 +7,9 @@ void value_zero_grad(Value *v);
 void value_backward(Value *v);
 void value_set_grad(Value *v, double grad);
 
+Value **value_topo(Value *v, size_t *count);
+void value_invalidate_topo(Value *v);
+
 void value_print_forward_graph(Value *v, const char *filename);
 void value_print_backward_graph(Value *v, const char *filename);
 void value_print_full_graph(Value *v, const char *filename);
@@ -0,0 +1,69 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "value.h"
+
+#define EXPORT_DEFAULT_BUFFER (1 << 20)
+#define EXPORT_BINARY_MAGIC "GGGRAPH"
+#define EXPORT_BINARY_VERSION 1
+
+typedef enum
+{
+    EXPORT_DOT,
+    EXPORT_JSON,
+    EXPORT_BINARY
+} ExportFormat;
+
+typedef enum
+{
+    EXPORT_FORWARD,
+    EXPORT_BACKWARD,
+    EXPORT_FULL
+} ExportView;
+
+typedef struct
+{
+    ExportFormat format;
+    ExportView view;
+    size_t max_nodes;
+    size_t max_depth;
+    size_t collapse_min;
+    size_t buffer_size;
+} ExportOptions;
+
+typedef struct
+{
+    size_t nodes;
+    size_t edges;
+    size_t hidden;
+    size_t collapsed;
+    size_t bytes;
+} ExportStats;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t root;
+    uint64_t node_count;
+    uint64_t edge_count;
+} ExportBinaryHeader;
+
+typedef struct
+{
+    double data;
+    double grad;
+    uint32_t op;
+    uint32_t count;
+    uint32_t hidden_inputs;
+    uint32_t reserved;
+} ExportBinaryNode;
+
+ExportOptions export_options(ExportFormat format, ExportView view);
+int value_export(Value *root, FILE *out, const ExportOptions *options, ExportStats *stats);
+int value_export_file(Value *root, const char *path, const ExportOptions *options, ExportStats *stats);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef FUSE_H
+#define FUSE_H
+
+#include <stdint.h>
+#include "value.h"
+
+#define FUSE_MAX_CODE 32
+#define FUSE_MAX_INPUTS 8
+
+typedef enum
+{
+    FUSE_INPUT,
+    FUSE_CONST,
+    FUSE_ADD,
+    FUSE_SUB,
+    FUSE_MUL,
+    FUSE_DIV,
+    FUSE_POW,
+    FUSE_RELU,
+    FUSE_TANH
+} FuseOp;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t a;
+    uint8_t b;
+    double k;
+} FuseInstr;
+
+typedef enum
+{
+    FUSE_SHAPE_GENERIC,
+    FUSE_SHAPE_BINARY,
+    FUSE_SHAPE_MUL_ADD,
+    FUSE_SHAPE_MUL_SUB
+} FuseShape;
+
+typedef struct
+{
+    FuseInstr code[FUSE_MAX_CODE];
+    int count;
+    int inputs;
+    int failed;
+
+    uint8_t shape;
+    uint8_t op;
+    uint8_t act;
+    uint8_t slot[3];
+} FusedKernel;
+
+void fused_kernel_init(FusedKernel *k);
+
+int fused_input(FusedKernel *k);
+int fused_const(FusedKernel *k, double value);
+int fused_add(FusedKernel *k, int a, int b);
+int fused_sub(FusedKernel *k, int a, int b);
+int fused_mul(FusedKernel *k, int a, int b);
+int fused_div(FusedKernel *k, int a, int b);
+int fused_pow(FusedKernel *k, int base, double exponent);
+int fused_relu(FusedKernel *k, int x);
+int fused_tanh(FusedKernel *k, int x);
+
+double fused_forward(const FusedKernel *k, const double *inputs, double *regs);
+void fused_backward(const FusedKernel *k, const double *inputs, double out, double grad, double *input_grads);
+
+/* Nodes keep a pointer to k, so it must outlive every node built from it. */
+Value *value_fused(const FusedKernel *k, Value **inputs);
+void backward_fused(Value *self);
+
+#endif
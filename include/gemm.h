@@ -0,0 +1,22 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stddef.h>
+#include "precision.h"
+
+typedef enum
+{
+    GEMM_ISA_AUTO,
+    GEMM_ISA_SCALAR,
+    GEMM_ISA_AVX2,
+    GEMM_ISA_AVX512
+} GemmIsa;
+
+int gemm(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+         const real_t *a, size_t lda, const real_t *b, size_t ldb,
+         real_t *c, size_t ldc, int accumulate);
+
+int gemm_set_isa(GemmIsa isa);
+const char *gemm_isa_name(void);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "value.h"
+
+typedef struct Graph Graph;
+
+typedef struct
+{
+    size_t nodes_before;
+    size_t nodes_after;
+    size_t folded;
+    size_t identities;
+    size_t merged;
+} GraphOptStats;
+
+Graph *graph_capture(Value *root, Value **leaves, size_t leaf_count,
+                     Value **outputs, size_t output_count);
+void graph_free(Graph *graph);
+
+/* Leaves not bound in graph_capture are constants. Constant ops are folded,
+   x + 0, x - 0, x * 1, x / 1, x ^ 1 and zero sum terms are removed, equal
+   nodes are merged and unreachable ones dropped. Softmax cross-entropy
+   labels are never folded, so graph_set_label keeps working. */
+int graph_optimize(Graph *graph, GraphOptStats *stats);
+
+size_t graph_node_count(Graph *graph);
+size_t graph_instr_count(Graph *graph);
+size_t graph_run_count(Graph *graph);
+
+int graph_set_label(Graph *graph, int label);
+double graph_forward(Graph *graph);
+void graph_backward(Graph *graph);
+double graph_output(Graph *graph, size_t index);
+
+#endif
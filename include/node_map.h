@@ -0,0 +1,24 @@
+#ifndef NODE_MAP_H
+#define NODE_MAP_H
+
+#include <stddef.h>
+#include "value.h"
+
+typedef struct
+{
+    Value **keys;
+    size_t *vals;
+    unsigned int *stamps;
+    unsigned int epoch;
+    size_t capacity;
+    size_t count;
+} NodeMap;
+
+int node_map_init(NodeMap *map, size_t expected);
+void node_map_free(NodeMap *map);
+void node_map_clear(NodeMap *map);
+
+int node_map_insert(NodeMap *map, Value *key, size_t val);
+int node_map_get(const NodeMap *map, Value *key, size_t *val);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef OPTIM_H
+#define OPTIM_H
+
+#include <stddef.h>
+#include "value.h"
+#include "tensor.h"
+
+typedef enum
+{
+    OPTIM_SGD,
+    OPTIM_ADAM,
+    OPTIM_ADAMW
+} OptimKind;
+
+typedef struct
+{
+    OptimKind kind;
+    double lr;
+    double momentum;
+    double beta1;
+    double beta2;
+    double eps;
+    double weight_decay;
+    double clip;
+} OptimConfig;
+
+typedef struct Optimizer Optimizer;
+
+OptimConfig optim_sgd(double lr, double momentum);
+OptimConfig optim_adam(double lr);
+OptimConfig optim_adamw(double lr, double weight_decay);
+
+Optimizer *optim_create(int num_threads);
+void optim_free(Optimizer *opt);
+
+int optim_add_values(Optimizer *opt, Value **params, size_t count, OptimConfig config);
+int optim_add_tensor(Optimizer *opt, Tensor *t, OptimConfig config);
+
+size_t optim_param_count(Optimizer *opt);
+void optim_set_lr(Optimizer *opt, double lr);
+void optim_step(Optimizer *opt);
+
+size_t optim_state_size(Optimizer *opt);
+int optim_get_state(Optimizer *opt, double *state, size_t count);
+int optim_set_state(Optimizer *opt, const double *state, size_t count);
+
+#endif
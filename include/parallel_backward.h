@@ -0,0 +1,9 @@
+#ifndef PARALLEL_BACKWARD_H
+#define PARALLEL_BACKWARD_H
+
+#include "value.h"
+#include "thread_pool.h"
+
+void value_backward_parallel(Value *v, ThreadPool *pool);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#ifdef GIGAGRAD_FLOAT32
+typedef float real_t;
+#define REAL_NAME "float32"
+#else
+typedef double real_t;
+#define REAL_NAME "float64"
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "value.h"
+
+#define PROFILE_MAX_OPS 64
+#define PROFILE_DEFAULT_EVENTS (1 << 20)
+
+typedef struct
+{
+    const char *op;
+    int tensor;
+    size_t nodes;
+    uint64_t forward_ns;
+    size_t backward_calls;
+    uint64_t backward_ns;
+    size_t bytes;
+} ProfileOpStats;
+
+int profile_enabled(void);
+void profile_reset(void);
+
+size_t profile_get_stats(ProfileOpStats *stats, size_t max);
+void profile_print(FILE *out);
+
+int profile_trace_begin(size_t max_events);
+void profile_trace_end(void);
+size_t profile_trace_dropped(void);
+int profile_write_trace(const char *filename);
+int profile_write_folded(const char *filename);
+
+void profile_region_begin(const char *name);
+void profile_region_end(void);
+
+uint64_t profile_forward_begin(void);
+void profile_forward_end(uint64_t start, const char *op, int tensor, size_t nodes);
+void profile_run_backward(Value *node);
+void profile_alloc(size_t bytes);
+
+#ifdef GIGAGRAD_PROFILE
+#define PROFILE_FORWARD_BEGIN() uint64_t profile_start_ = profile_forward_begin()
+#define PROFILE_FORWARD_END(op, nodes) profile_forward_end(profile_start_, op, 0, nodes)
+#define PROFILE_TENSOR_END(op) profile_forward_end(profile_start_, op, 1, 1)
+#define PROFILE_BACKWARD(node) profile_run_backward(node)
+#define PROFILE_ALLOC(bytes) profile_alloc(bytes)
+#else
+#define PROFILE_FORWARD_BEGIN() ((void)0)
+#define PROFILE_FORWARD_END(op, nodes) ((void)0)
+#define PROFILE_TENSOR_END(op) ((void)0)
+#define PROFILE_BACKWARD(node) ((node)->backward(node))
+#define PROFILE_ALLOC(bytes) ((void)0)
+#endif
+
+#endif
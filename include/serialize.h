@@ -0,0 +1,74 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "value.h"
+#include "tensor.h"
+#include "optim.h"
+
+#define MODEL_MAGIC "GGMODEL"
+#define MODEL_VERSION 1
+#define MODEL_BYTE_ORDER 0x01020304u
+#define MODEL_ALIGN 64
+#define MODEL_NAME_SIZE 48
+
+typedef enum
+{
+    MODEL_SECTION_VALUES = 1,
+    MODEL_SECTION_TENSOR = 2,
+    MODEL_SECTION_OPTIM = 3
+} ModelSectionKind;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t epoch;
+    uint64_t step;
+    uint64_t section_count;
+    uint64_t file_size;
+    uint8_t reserved[16];
+} ModelHeader;
+
+typedef struct
+{
+    char name[MODEL_NAME_SIZE];
+    uint32_t kind;
+    uint32_t elem_size;
+    uint32_t ndim;
+    uint32_t reserved;
+    uint64_t shape[TENSOR_MAX_DIMS];
+    uint64_t count;
+    uint64_t offset;
+    uint64_t checksum;
+    uint64_t padding;
+} ModelSection;
+
+typedef struct ModelWriter ModelWriter;
+typedef struct ModelFile ModelFile;
+
+ModelWriter *model_writer_create(void);
+void model_writer_free(ModelWriter *w);
+
+int model_writer_add_values(ModelWriter *w, const char *name, Value **values, size_t count);
+int model_writer_add_tensor(ModelWriter *w, const char *name, Tensor *t);
+int model_writer_add_optim(ModelWriter *w, const char *name, Optimizer *opt);
+int model_writer_save(ModelWriter *w, const char *path, uint64_t epoch, uint64_t step);
+
+ModelFile *model_open(const char *path);
+void model_close(ModelFile *m);
+int model_verify(ModelFile *m);
+
+uint64_t model_epoch(ModelFile *m);
+uint64_t model_step(ModelFile *m);
+const ModelSection *model_find(ModelFile *m, const char *name);
+const void *model_section_data(ModelFile *m, const ModelSection *section);
+
+int model_load_values(ModelFile *m, const char *name, Value **values, size_t count);
+int model_load_tensor(ModelFile *m, const char *name, Tensor *t);
+int model_load_optim(ModelFile *m, const char *name, Optimizer *opt);
+Tensor *model_map_tensor(ModelFile *m, const char *name);
+
+#endif
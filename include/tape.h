@@ -0,0 +1,38 @@
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <stddef.h>
+
+#define TAPE_DEFAULT_BLOCK_SIZE (1 << 20)
+
+typedef struct TapeBlock TapeBlock;
+typedef struct Tape Tape;
+
+struct TapeBlock
+{
+    TapeBlock *next;
+    size_t size;
+    size_t used;
+};
+
+struct Tape
+{
+    TapeBlock *head;
+    TapeBlock *current;
+    size_t block_size;
+    size_t bytes_used;
+    size_t bytes_reserved;
+};
+
+Tape *tape_create(size_t block_size);
+void tape_free(Tape *tape);
+void tape_reset(Tape *tape);
+
+void *tape_alloc(Tape *tape, size_t size);
+int tape_owns(Tape *tape, const void *ptr);
+
+void tape_begin(Tape *tape);
+void tape_end(void);
+Tape *tape_active(void);
+
+#endif
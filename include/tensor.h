@@ -0,0 +1,50 @@
+#ifndef TENSOR_H
+#define TENSOR_H
+
+#include <stddef.h>
+#include "value.h"
+#include "precision.h"
+
+#define TENSOR_MAX_DIMS 4
+
+typedef struct Tensor Tensor;
+
+struct Tensor
+{
+    real_t *data;
+    real_t *grad;
+
+    size_t shape[TENSOR_MAX_DIMS];
+    size_t strides[TENSOR_MAX_DIMS];
+    int ndim;
+    size_t size;
+
+    Value *node;
+    Tensor *base;
+    const char *op;
+    int grad_lock;
+};
+
+Tensor *tensor_create(const size_t *shape, int ndim);
+Tensor *tensor_from_data(const real_t *data, const size_t *shape, int ndim);
+Tensor *tensor_wrap(real_t *data, const size_t *shape, int ndim);
+void tensor_free(Tensor *t);
+
+int tensor_is_contiguous(Tensor *t);
+void tensor_zero_grad(Tensor *t);
+
+Tensor *tensor_transpose(Tensor *t);
+
+Tensor *tensor_add(Tensor *a, Tensor *b);
+Tensor *tensor_mul(Tensor *a, Tensor *b);
+Tensor *tensor_matmul(Tensor *a, Tensor *b);
+Tensor *tensor_relu(Tensor *x);
+Tensor *tensor_tanh(Tensor *x);
+Tensor *tensor_softmax(Tensor *x);
+
+Value *tensor_sum(Tensor *t);
+Value *tensor_cross_entropy(Tensor *probs, const int *labels);
+
+const char *tensor_get_op_symbol(Value *node);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*ThreadPoolFn)(void *ctx, int worker);
+
+ThreadPool *thread_pool_create(int num_threads);
+void thread_pool_free(ThreadPool *pool);
+
+int thread_pool_size(ThreadPool *pool);
+void thread_pool_run(ThreadPool *pool, ThreadPoolFn fn, void *ctx);
+
+int thread_pool_default_threads(void);
+
+#endif
@@ -3,8 +3,37 @@
 
 #include <stddef.h>
 
+#define VALUE_FLAG_TAPE 0x1
+#define VALUE_FLAG_TENSOR 0x2
+#define VALUE_FLAG_LAZY 0x4
+
 typedef struct Value Value;
 
+typedef enum
+{
+    VALUE_OP_LEAF,
+    VALUE_OP_ADD,
+    VALUE_OP_SUB,
+    VALUE_OP_MUL,
+    VALUE_OP_DIV,
+    VALUE_OP_POW,
+    VALUE_OP_RELU,
+    VALUE_OP_TANH,
+    VALUE_OP_SUM,
+    VALUE_OP_DOT,
+    VALUE_OP_SOFTMAX,
+    VALUE_OP_SOFTMAX_CE,
+    VALUE_OP_FUSED,
+    VALUE_OP_TENSOR,
+    VALUE_OP_CUSTOM
+} ValueOp;
+
+typedef struct
+{
+    int index;
+    double log_sum;
+} SoftmaxCtx;
+
 typedef void (*BackwardFn)(Value *self);
 
 struct Value
@@ -17,12 +46,36 @@ struct Value
 
     BackwardFn backward;
     void *backward_ctx;
-    int visited;
+
+    Value **topo;
+    size_t topo_count;
+
+    struct Tape *tape;
+    unsigned int flags;
 };
 
 Value *value_create(double data);
 void value_free(Value *v);
 
+void *value_alloc_owned(Value *v, size_t size);
+Value **value_alloc_prev(Value *v, size_t n);
+void *value_alloc_ctx(Value *v, size_t size);
+
+void value_no_grad_begin(void);
+void value_no_grad_end(void);
+int value_grad_enabled(void);
+
+void value_lazy_begin(void);
+void value_lazy_end(void);
+int value_lazy_enabled(void);
+int value_defer(Value **xs, size_t n);
+double value_realize(Value *v);
+void value_realize_topo(Value **topo, size_t count);
+
+void value_grad_add(double *slot, double delta);
+void value_set_atomic_grads(int enabled);
+int value_atomic_grads(void);
+
 Value *value_add(Value *a, Value *b);
 Value *value_sub(Value *a, Value *b);
 Value *value_mul(Value *a, Value *b);
@@ -30,13 +83,17 @@ Value *value_div(Value *a, Value *b);
 Value *value_relu(Value *x);
 Value *value_pow(Value *base, double exponent);
 Value *value_tanh(Value *x);
+Value *value_sum(Value **xs, int n);
+Value *value_dot(Value **a, Value **b, int n);
 
 Value **value_softmax(Value **inputs, int n);
+Value *value_softmax_cross_entropy(Value **logits, int label, int n);
 void value_zero_grad(Value *v);
 void value_backward(Value *v);
 
 void value_print(Value *v);
 
+ValueOp value_get_op(Value *v);
 const char *value_get_op_symbol(Value *v);
 void value_get_label(Value *v, char *buf, size_t size);
 void value_get_forward_label(Value *v, char *buf, size_t size);
@@ -0,0 +1,204 @@
+#include "../include/batch.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/thread_pool.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+    Value *shadows;
+    Value **shadow_ptrs;
+    double *grads;
+    Tape *tape;
+    int failed;
+} BatchWorker;
+
+struct BatchRunner
+{
+    Value **params;
+    size_t param_count;
+
+    ThreadPool *pool;
+    BatchWorker *workers;
+    int num_workers;
+
+    BatchSampleFn fn;
+    BatchGradFn grad_fn;
+    void *user;
+    int end;
+    int samples;
+    atomic_int next;
+};
+
+static void batch_worker_free(BatchWorker *worker)
+{
+    free(worker->shadows);
+    free(worker->shadow_ptrs);
+    free(worker->grads);
+    tape_free(worker->tape);
+}
+
+BatchRunner *batch_runner_create(Value **params, size_t param_count, int num_threads)
+{
+    BatchRunner *runner = calloc(1, sizeof(BatchRunner));
+    if (!runner)
+        return NULL;
+
+    runner->params = params;
+    runner->param_count = param_count;
+    runner->pool = thread_pool_create(num_threads);
+    if (!runner->pool)
+    {
+        free(runner);
+        return NULL;
+    }
+
+    runner->num_workers = thread_pool_size(runner->pool);
+    runner->workers = calloc(runner->num_workers, sizeof(BatchWorker));
+    if (!runner->workers)
+    {
+        batch_runner_free(runner);
+        return NULL;
+    }
+
+    for (int w = 0; w < runner->num_workers; w++)
+    {
+        BatchWorker *worker = &runner->workers[w];
+        worker->shadows = calloc(param_count, sizeof(Value));
+        worker->shadow_ptrs = malloc(param_count * sizeof(Value *));
+        worker->grads = calloc(param_count, sizeof(double));
+        worker->tape = tape_create(TAPE_DEFAULT_BLOCK_SIZE);
+        if (!worker->shadows || !worker->shadow_ptrs || !worker->grads || !worker->tape)
+        {
+            batch_runner_free(runner);
+            return NULL;
+        }
+
+        for (size_t i = 0; i < param_count; i++)
+            worker->shadow_ptrs[i] = &worker->shadows[i];
+    }
+
+    return runner;
+}
+
+void batch_runner_free(BatchRunner *runner)
+{
+    if (!runner)
+        return;
+
+    if (runner->workers)
+    {
+        for (int w = 0; w < runner->num_workers; w++)
+            batch_worker_free(&runner->workers[w]);
+        free(runner->workers);
+    }
+    thread_pool_free(runner->pool);
+    free(runner);
+}
+
+int batch_runner_threads(BatchRunner *runner)
+{
+    return runner ? runner->num_workers : 0;
+}
+
+static void batch_worker_run(void *ctx, int w)
+{
+    BatchRunner *runner = ctx;
+    BatchWorker *worker = &runner->workers[w];
+    size_t param_count = runner->param_count;
+    Value **params = runner->params;
+
+    for (size_t i = 0; i < param_count; i++)
+    {
+        worker->shadows[i].data = params[i]->data;
+        worker->shadows[i].grad = 0.0;
+        worker->grads[i] = 0.0;
+    }
+    worker->failed = 0;
+
+    int sample;
+    while ((sample = atomic_fetch_add(&runner->next, 1)) < runner->end)
+    {
+        tape_begin(worker->tape);
+
+        if (runner->grad_fn)
+        {
+            if (!runner->grad_fn(runner->user, w, sample, worker->shadow_ptrs))
+                worker->failed = 1;
+        }
+        else
+        {
+            Value *loss = runner->fn(runner->user, w, sample, worker->shadow_ptrs);
+            if (loss)
+                value_backward(loss);
+            else
+                worker->failed = 1;
+        }
+
+        for (size_t i = 0; i < param_count; i++)
+        {
+            worker->grads[i] += worker->shadows[i].grad;
+            worker->shadows[i].grad = 0.0;
+        }
+
+        tape_end();
+        tape_reset(worker->tape);
+    }
+}
+
+/* Parameters get the mean over the batch, so the step size does not depend
+   on how many samples the batch held. */
+static void batch_reduce_run(void *ctx, int w)
+{
+    BatchRunner *runner = ctx;
+    size_t shard = (runner->param_count + runner->num_workers - 1) / runner->num_workers;
+    size_t begin = w * shard;
+    size_t end = begin + shard < runner->param_count ? begin + shard : runner->param_count;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        double grad = 0.0;
+        for (int k = 0; k < runner->num_workers; k++)
+            grad += runner->workers[k].grads[i];
+        runner->params[i]->grad = grad / runner->samples;
+    }
+}
+
+static int batch_runner_start(BatchRunner *runner, int begin, int end, void *user)
+{
+    runner->user = user;
+    runner->end = end;
+    runner->samples = end > begin ? end - begin : 1;
+    atomic_store(&runner->next, begin);
+
+    thread_pool_run(runner->pool, batch_worker_run, runner);
+    thread_pool_run(runner->pool, batch_reduce_run, runner);
+
+    for (int w = 0; w < runner->num_workers; w++)
+    {
+        if (runner->workers[w].failed)
+            return 0;
+    }
+    return 1;
+}
+
+int batch_runner_run(BatchRunner *runner, int begin, int end, BatchSampleFn fn, void *user)
+{
+    if (!runner || !fn)
+        return 0;
+
+    runner->fn = fn;
+    runner->grad_fn = NULL;
+    return batch_runner_start(runner, begin, end, user);
+}
+
+int batch_runner_run_grads(BatchRunner *runner, int begin, int end, BatchGradFn fn, void *user)
+{
+    if (!runner || !fn)
+        return 0;
+
+    runner->fn = NULL;
+    runner->grad_fn = fn;
+    return batch_runner_start(runner, begin, end, user);
+}
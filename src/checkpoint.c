@@ -0,0 +1,254 @@
+#include "../include/checkpoint.h"
+#include "../include/engine.h"
+#include "../include/tape.h"
+#include "../include/profile.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CHECKPOINT_MAX_DEPTH 8
+#define CHECKPOINT_TAPE_BLOCK_SIZE (256 * 1024)
+
+typedef struct
+{
+    CheckpointFn fn;
+    void *ctx;
+    size_t input_count;
+    Value **outputs;
+    size_t output_count;
+} CheckpointSegment;
+
+/* One scratch tape per nesting level, so a segment that itself contains
+   checkpoints never resets the tape its caller is still building on. */
+static _Thread_local Tape *scratch_tapes[CHECKPOINT_MAX_DEPTH];
+static _Thread_local int scratch_depth = 0;
+static _Thread_local CheckpointStats checkpoint_stats;
+
+static Tape *checkpoint_enter(void)
+{
+    if (scratch_depth >= CHECKPOINT_MAX_DEPTH)
+    {
+        fprintf(stderr, "[ERROR] Checkpoints nested deeper than %d levels\n", CHECKPOINT_MAX_DEPTH);
+        return NULL;
+    }
+
+    Tape **slot = &scratch_tapes[scratch_depth];
+    if (!*slot)
+        *slot = tape_create(CHECKPOINT_TAPE_BLOCK_SIZE);
+    if (!*slot)
+        return NULL;
+
+    scratch_depth++;
+    return *slot;
+}
+
+static void checkpoint_leave(Tape *scratch, Tape *caller)
+{
+    if (scratch->bytes_used > checkpoint_stats.peak_scratch_bytes)
+        checkpoint_stats.peak_scratch_bytes = scratch->bytes_used;
+
+    tape_reset(scratch);
+    scratch_depth--;
+
+    tape_end();
+    if (caller)
+        tape_begin(caller);
+}
+
+static void backward_checkpoint_output(Value *self)
+{
+    (void)self;
+}
+
+/* Backward over the recomputed segment only. Parameters the segment reads
+   sit on other tapes or the heap: they are prev of the segment node, so
+   the outer pass has already zeroed them, and they only receive
+   contributions here. Each
+   node records its tape, so membership is one compare rather than a walk
+   over the scratch tape's blocks. */
+static int checkpoint_sweep(Value *root, Tape *scratch)
+{
+    size_t count = 0;
+    Value **topo = value_topo(root, &count);
+    if (!topo)
+        return 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (topo[i]->tape == scratch)
+            topo[i]->grad = 0.0;
+    }
+
+    root->grad = 1.0;
+    for (size_t i = count; i-- > 0;)
+    {
+        if (topo[i]->backward && topo[i]->tape == scratch)
+            PROFILE_BACKWARD(topo[i]);
+    }
+    return 1;
+}
+
+/* Runs after every output in reverse order, so their grads are final.
+   The segment is rebuilt on fresh leaves and differentiated through
+   sum_j grad_j * output_j, which yields all input grads in one sweep. */
+static void backward_checkpoint_segment(Value *self)
+{
+    CheckpointSegment *seg = self->backward_ctx;
+    size_t n_in = seg->input_count, n_out = seg->output_count;
+    Tape *caller = tape_active();
+    Tape *scratch = checkpoint_enter();
+    if (!scratch)
+        return;
+
+    tape_begin(scratch);
+
+    Value **shadows = tape_alloc(scratch, (n_in + 2 * n_out) * sizeof(Value *));
+    Value **outputs = shadows ? shadows + n_in : NULL;
+    Value **seeds = shadows ? shadows + n_in + n_out : NULL;
+    int ok = shadows != NULL;
+
+    for (size_t i = 0; ok && i < n_in; i++)
+    {
+        shadows[i] = value_create(self->prev[i]->data);
+        ok = shadows[i] != NULL;
+    }
+    for (size_t j = 0; ok && j < n_out; j++)
+    {
+        outputs[j] = NULL;
+        seeds[j] = value_create(seg->outputs[j]->grad);
+        ok = seeds[j] != NULL;
+    }
+
+    ok = ok && seg->fn(seg->ctx, shadows, n_in, outputs, n_out);
+    for (size_t j = 0; ok && j < n_out; j++)
+        ok = outputs[j] != NULL;
+
+    Value *root = ok ? value_dot(outputs, seeds, (int)n_out) : NULL;
+    if (root && checkpoint_sweep(root, scratch))
+    {
+        checkpoint_stats.recomputes++;
+        for (size_t i = 0; i < n_in; i++)
+            value_grad_add(&self->prev[i]->grad, shadows[i]->grad);
+    }
+    else
+    {
+        fprintf(stderr, "[ERROR] Checkpoint segment failed to recompute\n");
+    }
+
+    checkpoint_leave(scratch, caller);
+}
+
+static int checkpoint_attach(Value **inputs, size_t input_count, Value **params, size_t param_count,
+                             Value **outputs, const double *data, size_t output_count,
+                             CheckpointFn fn, void *ctx)
+{
+    if (!value_grad_enabled())
+    {
+        for (size_t j = 0; j < output_count; j++)
+        {
+            outputs[j] = value_create(data[j]);
+            if (!outputs[j])
+                return 0;
+        }
+        return 1;
+    }
+
+    size_t prev_count = input_count + param_count;
+    Value *segment = value_create(0.0);
+    CheckpointSegment *seg = segment ? value_alloc_ctx(segment, sizeof(CheckpointSegment)) : NULL;
+    if (!seg || (prev_count && !value_alloc_prev(segment, prev_count)))
+        return 0;
+
+    seg->fn = fn;
+    seg->ctx = ctx;
+    seg->input_count = input_count;
+    seg->output_count = output_count;
+    seg->outputs = value_alloc_owned(segment, output_count * sizeof(Value *));
+    if (!seg->outputs)
+        return 0;
+
+    if (input_count)
+        memcpy(segment->prev, inputs, input_count * sizeof(Value *));
+    if (param_count)
+        memcpy(segment->prev + input_count, params, param_count * sizeof(Value *));
+    segment->backward = backward_checkpoint_segment;
+
+    for (size_t j = 0; j < output_count; j++)
+    {
+        Value *out = value_create(data[j]);
+        if (!out || !value_alloc_prev(out, 1))
+            return 0;
+        out->prev[0] = segment;
+        out->backward = backward_checkpoint_output;
+        seg->outputs[j] = out;
+        outputs[j] = out;
+    }
+    return 1;
+}
+
+int value_checkpoint(CheckpointFn fn, void *ctx, Value **inputs, size_t input_count,
+                     Value **params, size_t param_count, Value **outputs, size_t output_count)
+{
+    if (!fn || !outputs || output_count == 0 || (input_count && !inputs) || (param_count && !params))
+    {
+        fprintf(stderr, "[ERROR] Invalid arguments to value_checkpoint\n");
+        return 0;
+    }
+
+    Tape *caller = tape_active();
+    if (!caller)
+    {
+        fprintf(stderr, "[ERROR] value_checkpoint requires an active tape\n");
+        return 0;
+    }
+
+    for (size_t i = 0; i < input_count; i++)
+        value_realize(inputs[i]);
+    for (size_t i = 0; i < param_count; i++)
+        value_realize(params[i]);
+
+    Tape *scratch = checkpoint_enter();
+    if (!scratch)
+        return 0;
+
+    /* The forward pass runs without grad tracking on the scratch tape, so
+       the segment's interior nodes are dropped as soon as it returns. */
+    tape_begin(scratch);
+    double *data = tape_alloc(scratch, output_count * sizeof(double));
+    Value **results = tape_alloc(scratch, output_count * sizeof(Value *));
+    if (results)
+        memset(results, 0, output_count * sizeof(Value *));
+
+    value_no_grad_begin();
+    int ok = data && results && fn(ctx, inputs, input_count, results, output_count);
+    value_no_grad_end();
+
+    for (size_t j = 0; ok && j < output_count; j++)
+    {
+        ok = results[j] != NULL;
+        if (ok)
+            data[j] = results[j]->data;
+    }
+
+    tape_begin(caller);
+    ok = ok && checkpoint_attach(inputs, input_count, params, param_count, outputs, data,
+                                   output_count, fn, ctx);
+
+    checkpoint_stats.segments++;
+    checkpoint_stats.released_bytes += scratch->bytes_used;
+    checkpoint_leave(scratch, caller);
+
+    if (!ok)
+        fprintf(stderr, "[ERROR] Checkpoint segment failed\n");
+    return ok;
+}
+
+void checkpoint_get_stats(CheckpointStats *stats)
+{
+    if (stats)
+        *stats = checkpoint_stats;
+}
+
+void checkpoint_reset_stats(void)
+{
+    memset(&checkpoint_stats, 0, sizeof(checkpoint_stats));
+}
@@ -0,0 +1,185 @@
+#include "../include/dual.h"
+#include <math.h>
+#include <string.h>
+
+Dual dual_make(double val, double dot)
+{
+    return (Dual){val, dot};
+}
+
+Dual dual_const(double val)
+{
+    return (Dual){val, 0.0};
+}
+
+Dual dual_add(Dual a, Dual b)
+{
+    return (Dual){a.val + b.val, a.dot + b.dot};
+}
+
+Dual dual_sub(Dual a, Dual b)
+{
+    return (Dual){a.val - b.val, a.dot - b.dot};
+}
+
+Dual dual_mul(Dual a, Dual b)
+{
+    return (Dual){a.val * b.val, a.dot * b.val + a.val * b.dot};
+}
+
+Dual dual_div(Dual a, Dual b)
+{
+    return (Dual){a.val / b.val, (a.dot * b.val - a.val * b.dot) / (b.val * b.val)};
+}
+
+Dual dual_pow(Dual base, double exponent)
+{
+    return (Dual){pow(base.val, exponent), exponent * pow(base.val, exponent - 1) * base.dot};
+}
+
+Dual dual_relu(Dual x)
+{
+    return x.val > 0 ? x : (Dual){0.0, 0.0};
+}
+
+Dual dual_tanh(Dual x)
+{
+    double t = tanh(x.val);
+    return (Dual){t, (1 - t * t) * x.dot};
+}
+
+Dual dual_sum(const Dual *xs, int n)
+{
+    Dual out = {0.0, 0.0};
+    for (int i = 0; i < n; i++)
+    {
+        out.val += xs[i].val;
+        out.dot += xs[i].dot;
+    }
+    return out;
+}
+
+Dual dual_dot(const Dual *a, const Dual *b, int n)
+{
+    Dual out = {0.0, 0.0};
+    for (int i = 0; i < n; i++)
+    {
+        out.val += a[i].val * b[i].val;
+        out.dot += a[i].dot * b[i].val + a[i].val * b[i].dot;
+    }
+    return out;
+}
+
+/* The multi-tangent ops always sweep all DUAL_MAX_TANGENTS lanes: unused
+   lanes stay zero, and the fixed trip count lets the loops vectorize.
+   Every op reads its operands into locals first so out may alias them. */
+void dualvec_const(DualVec *out, double val)
+{
+    out->val = val;
+    memset(out->dot, 0, sizeof(out->dot));
+}
+
+void dualvec_seed(DualVec *out, double val, int tangent)
+{
+    dualvec_const(out, val);
+    if (tangent >= 0 && tangent < DUAL_MAX_TANGENTS)
+        out->dot[tangent] = 1.0;
+}
+
+void dualvec_add(DualVec *out, const DualVec *a, const DualVec *b)
+{
+    DualVec r;
+    r.val = a->val + b->val;
+    for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+        r.dot[i] = a->dot[i] + b->dot[i];
+    *out = r;
+}
+
+void dualvec_sub(DualVec *out, const DualVec *a, const DualVec *b)
+{
+    DualVec r;
+    r.val = a->val - b->val;
+    for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+        r.dot[i] = a->dot[i] - b->dot[i];
+    *out = r;
+}
+
+void dualvec_mul(DualVec *out, const DualVec *a, const DualVec *b)
+{
+    DualVec r;
+    double av = a->val, bv = b->val;
+    r.val = av * bv;
+    for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+        r.dot[i] = a->dot[i] * bv + av * b->dot[i];
+    *out = r;
+}
+
+void dualvec_div(DualVec *out, const DualVec *a, const DualVec *b)
+{
+    DualVec r;
+    double av = a->val, bv = b->val;
+    double inv = 1.0 / bv, scale = av * inv * inv;
+    r.val = av / bv;
+    for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+        r.dot[i] = a->dot[i] * inv - b->dot[i] * scale;
+    *out = r;
+}
+
+void dualvec_pow(DualVec *out, const DualVec *base, double exponent)
+{
+    DualVec r;
+    double x = base->val;
+    double scale = exponent * pow(x, exponent - 1);
+    r.val = pow(x, exponent);
+    for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+        r.dot[i] = scale * base->dot[i];
+    *out = r;
+}
+
+void dualvec_relu(DualVec *out, const DualVec *x)
+{
+    if (x->val > 0)
+    {
+        *out = *x;
+        return;
+    }
+    dualvec_const(out, 0.0);
+}
+
+void dualvec_tanh(DualVec *out, const DualVec *x)
+{
+    DualVec r;
+    double t = tanh(x->val);
+    double scale = 1 - t * t;
+    r.val = t;
+    for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+        r.dot[i] = scale * x->dot[i];
+    *out = r;
+}
+
+void dualvec_sum(DualVec *out, const DualVec *xs, int n)
+{
+    DualVec r;
+    dualvec_const(&r, 0.0);
+    for (int k = 0; k < n; k++)
+    {
+        r.val += xs[k].val;
+        for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+            r.dot[i] += xs[k].dot[i];
+    }
+    *out = r;
+}
+
+void dualvec_dot(DualVec *out, const DualVec *a, const DualVec *b, int n)
+{
+    DualVec r;
+    dualvec_const(&r, 0.0);
+    for (int k = 0; k < n; k++)
+    {
+        double av = a[k].val, bv = b[k].val;
+        r.val += av * bv;
+        for (int i = 0; i < DUAL_MAX_TANGENTS; i++)
+            r.dot[i] += a[k].dot[i] * bv + av * b[k].dot[i];
+    }
+    *out = r;
+}
@@ -1,6 +1,11 @@
 #include "../include/engine.h"
+#include "../include/tensor.h"
+#include "../include/node_map.h"
+#include "../include/profile.h"
+#include "../include/export.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 
 static void ensure_output_dir()
@@ -16,76 +21,113 @@ static void ensure_output_dir()
     }
 }
 
-static void build_topo(Value *v, Value **topo, size_t *idx)
+typedef struct
 {
-    if (!v || v->visited || !topo || !idx)
-        return;
+    Value *node;
+    size_t next;
+} TopoFrame;
 
-    v->visited = 1;
+typedef struct
+{
+    NodeMap seen;
+    TopoFrame *stack;
+    size_t stack_cap;
+    Value **order;
+    size_t order_cap;
+} TopoScratch;
 
-    if (v->prev)
-    {
-        for (size_t i = 0; i < v->prev_count; i++)
-        {
-            if (v->prev[i])
-                build_topo(v->prev[i], topo, idx);
-        }
-    }
+static _Thread_local TopoScratch topo_scratch;
 
-    topo[*idx] = v;
-    (*idx)++;
+static int grow_buffer(void **buf, size_t *cap, size_t elem_size)
+{
+    size_t new_cap = *cap ? *cap * 2 : 64;
+    void *grown = realloc(*buf, new_cap * elem_size);
+    if (!grown)
+        return 0;
+    *buf = grown;
+    *cap = new_cap;
+    return 1;
 }
 
-static void count_nodes(Value *node, size_t *count)
+static size_t build_topo(Value *root, TopoScratch *scratch)
 {
-    if (!node || !count)
-        return;
+    size_t count = 0, depth = 0;
 
-    if (node->visited)
-        return;
+    if (!scratch->seen.capacity && !node_map_init(&scratch->seen, 0))
+        return 0;
+    if (!scratch->stack && !grow_buffer((void **)&scratch->stack, &scratch->stack_cap, sizeof(TopoFrame)))
+        return 0;
 
-    node->visited = 1;
-    (*count)++;
+    node_map_clear(&scratch->seen);
+    node_map_insert(&scratch->seen, root, 0);
+    scratch->stack[depth++] = (TopoFrame){root, 0};
 
-    if (node->prev)
+    while (depth > 0)
     {
-        for (size_t i = 0; i < node->prev_count; i++)
+        TopoFrame *top = &scratch->stack[depth - 1];
+        Value *node = top->node;
+
+        if (top->next < node->prev_count)
         {
-            if (node->prev[i])
-            {
-                count_nodes(node->prev[i], count);
-            }
+            Value *parent = node->prev[top->next++];
+            if (!parent)
+                continue;
+
+            int inserted = node_map_insert(&scratch->seen, parent, 0);
+            if (inserted < 0)
+                return 0;
+            if (!inserted)
+                continue;
+
+            if (depth == scratch->stack_cap &&
+                !grow_buffer((void **)&scratch->stack, &scratch->stack_cap, sizeof(TopoFrame)))
+                return 0;
+            scratch->stack[depth++] = (TopoFrame){parent, 0};
+            continue;
         }
+
+        if (count == scratch->order_cap &&
+            !grow_buffer((void **)&scratch->order, &scratch->order_cap, sizeof(Value *)))
+            return 0;
+        scratch->order[count++] = node;
+        depth--;
     }
+
+    return count;
 }
 
-static void reset_visited(Value *node)
+Value **value_topo(Value *v, size_t *count)
 {
-    if (!node || !node->visited)
-        return;
-
-    node->visited = 0;
+    if (!v || !count)
+        return NULL;
 
-    if (node->prev)
+    if (!v->topo)
     {
-        for (size_t i = 0; i < node->prev_count; i++)
-        {
-            if (node->prev[i])
-            {
-                reset_visited(node->prev[i]);
-            }
-        }
+        size_t n = build_topo(v, &topo_scratch);
+        if (n == 0)
+            return NULL;
+
+        /* Lives on the root's own tape, whichever tape is active now. */
+        v->topo = value_alloc_owned(v, n * sizeof(Value *));
+        if (!v->topo)
+            return NULL;
+        memcpy(v->topo, topo_scratch.order, n * sizeof(Value *));
+        v->topo_count = n;
     }
+
+    *count = v->topo_count;
+    return v->topo;
 }
 
-static void write_graph_header(FILE *f, const char *title)
+void value_invalidate_topo(Value *v)
 {
-    fprintf(f, "digraph G {\n");
-    fprintf(f, "    rankdir=LR;\n");
-    fprintf(f, "    bgcolor=\"#ffffff\";\n");
-    fprintf(f, "    title=\"%s\";\n", title);
-    fprintf(f, "    node [shape=record, style=filled, fillcolor=\"#f8e8e8\", fontsize=10];\n");
-    fprintf(f, "    edge [color=\"#2c3e50\"];\n\n");
+    if (!v || !v->topo)
+        return;
+
+    if (!(v->flags & VALUE_FLAG_TAPE))
+        free(v->topo);
+    v->topo = NULL;
+    v->topo_count = 0;
 }
 
 void value_zero_grad(Value *v)
@@ -93,7 +135,6 @@ void value_zero_grad(Value *v)
     if (!v)
         return;
     v->grad = 0.0;
-    v->visited = 0;
 }
 
 void value_backward(Value *v)
@@ -101,41 +142,28 @@ void value_backward(Value *v)
     if (!v)
         return;
 
-    size_t node_count = 0;
-    Value **topo = NULL;
-    size_t topo_idx = 0;
-
-    reset_visited(v);
-    count_nodes(v, &node_count);
-    reset_visited(v);
-
-    if (node_count == 0)
-        return;
-
-    topo = malloc(node_count * sizeof(Value *));
+    size_t topo_count = 0;
+    Value **topo = value_topo(v, &topo_count);
     if (!topo)
         return;
 
-    build_topo(v, topo, &topo_idx);
-    if (topo_idx != node_count)
-    {
-        free(topo);
-        return;
-    }
+    if (v->flags & VALUE_FLAG_LAZY)
+        value_realize_topo(topo, topo_count);
 
-    for (size_t i = 0; i < topo_idx; i++)
+    for (size_t i = 0; i < topo_count; i++)
+    {
         topo[i]->grad = 0.0;
+        if (topo[i]->flags & VALUE_FLAG_TENSOR)
+            tensor_zero_grad(topo[i]->backward_ctx);
+    }
 
     v->grad = 1.0;
 
-    for (int i = (int)topo_idx - 1; i >= 0; i--)
+    for (size_t i = topo_count; i-- > 0;)
     {
-        if (topo[i] && topo[i]->backward)
-            topo[i]->backward(topo[i]);
+        if (topo[i]->backward)
+            PROFILE_BACKWARD(topo[i]);
     }
-
-    reset_visited(v);
-    free(topo);
 }
 
 void value_set_grad(Value *v, double grad)
@@ -144,7 +172,7 @@ void value_set_grad(Value *v, double grad)
         v->grad = grad;
 }
 
-void value_print_forward_graph(Value *v, const char *filename)
+static void print_graph(Value *v, const char *filename, ExportView view)
 {
     if (!v || !filename)
         return;
@@ -153,273 +181,21 @@ void value_print_forward_graph(Value *v, const char *filename)
     char filepath[256];
     snprintf(filepath, sizeof(filepath), "output/%s", filename);
 
-    FILE *f = fopen(filepath, "w");
-    if (!f)
-        return;
-
-    write_graph_header(f, "Forward Computation Graph");
-
-    fprintf(f, "    compound=true;\n");
-    fprintf(f, "    splines=ortho;\n");
-    fprintf(f, "    nodesep=0.5;\n");
-    fprintf(f, "    ranksep=0.7;\n\n");
-
-    reset_visited(v);
-    size_t node_count = 0;
-    count_nodes(v, &node_count);
-    reset_visited(v);
-
-    Value **nodes = malloc(node_count * sizeof(Value *));
-    if (!nodes)
-    {
-        fclose(f);
-        return;
-    }
-
-    size_t idx = 0;
-    build_topo(v, nodes, &idx);
-
-    if (idx != node_count)
-    {
-        free(nodes);
-        fclose(f);
-        return;
-    }
-
-    fprintf(f, "    subgraph cluster_0 {\n");
-    fprintf(f, "        style=filled;\n");
-    fprintf(f, "        fillcolor=\"#f8e8e8\";\n");
-    fprintf(f, "        color=\"#2c3e50\";\n");
-    fprintf(f, "        label=\"Forward Pass\";\n");
-    fprintf(f, "        fontsize=12;\n");
-
-    fprintf(f, "        { rank=same; ");
-    for (size_t i = 0; i < idx; i++)
-    {
-        if (!nodes[i]->prev)
-        {
-            fprintf(f, "n%p; ", (void *)nodes[i]);
-        }
-    }
-    fprintf(f, "}\n");
-
-    for (size_t i = 0; i < idx; i++)
-    {
-        char label[100];
-        value_get_forward_label(nodes[i], label, sizeof(label));
-        fprintf(f, "        n%p [label=\"%s\"];\n", (void *)nodes[i], label);
-    }
-
-    fprintf(f, "    }\n");
-
-    reset_visited(v);
-    for (size_t i = 0; i < idx; i++)
-    {
-        Value *node = nodes[i];
-        for (size_t j = 0; j < node->prev_count; j++)
-        {
-            if (node->prev[j])
-            {
-                fprintf(f, "    n%p -> n%p [weight=2];\n",
-                        (void *)node->prev[j], (void *)node);
-            }
-        }
-    }
+    ExportOptions options = export_options(EXPORT_DOT, view);
+    value_export_file(v, filepath, &options, NULL);
+}
 
-    fprintf(f, "}\n");
-    fclose(f);
-    free(nodes);
-    reset_visited(v);
+void value_print_forward_graph(Value *v, const char *filename)
+{
+    print_graph(v, filename, EXPORT_FORWARD);
 }
 
 void value_print_backward_graph(Value *v, const char *filename)
 {
-    if (!v || !filename)
-        return;
-
-    ensure_output_dir();
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "output/%s", filename);
-
-    FILE *f = fopen(filepath, "w");
-    if (!f)
-        return;
-
-    write_graph_header(f, "Backward Computation Graph");
-
-    fprintf(f, "    compound=true;\n");
-    fprintf(f, "    splines=ortho;\n");
-    fprintf(f, "    nodesep=0.5;\n");
-    fprintf(f, "    ranksep=0.7;\n\n");
-
-    reset_visited(v);
-    size_t node_count = 0;
-    count_nodes(v, &node_count);
-    reset_visited(v);
-
-    Value **nodes = malloc(node_count * sizeof(Value *));
-    if (!nodes)
-    {
-        fclose(f);
-        return;
-    }
-
-    size_t idx = 0;
-    build_topo(v, nodes, &idx);
-
-    if (idx != node_count)
-    {
-        free(nodes);
-        fclose(f);
-        return;
-    }
-
-    fprintf(f, "    subgraph cluster_0 {\n");
-    fprintf(f, "        style=filled;\n");
-    fprintf(f, "        fillcolor=\"#f8e8e8\";\n");
-    fprintf(f, "        color=\"#2c3e50\";\n");
-    fprintf(f, "        label=\"Backward Pass\";\n");
-    fprintf(f, "        fontsize=12;\n");
-
-    fprintf(f, "        { rank=same; ");
-    for (size_t i = idx - 1; i < idx; i--)
-    {
-        if (nodes[i]->prev_count == 0)
-        {
-            fprintf(f, "n%p; ", (void *)nodes[i]);
-        }
-    }
-    fprintf(f, "}\n");
-
-    for (size_t i = 0; i < idx; i++)
-    {
-        char label[100];
-        value_get_label(nodes[i], label, sizeof(label));
-        fprintf(f, "        n%p [label=\"%s\"];\n", (void *)nodes[i], label);
-    }
-
-    fprintf(f, "    }\n");
-
-    fprintf(f, "\n    edge [color=\"#e74c3c\", style=dashed];\n");
-
-    for (size_t i = 0; i < idx; i++)
-    {
-        Value *node = nodes[i];
-        for (size_t j = 0; j < node->prev_count; j++)
-        {
-            if (node->prev[j])
-            {
-                fprintf(f, "    n%p -> n%p [weight=2];\n",
-                        (void *)node, (void *)node->prev[j]);
-            }
-        }
-    }
-
-    fprintf(f, "}\n");
-    fclose(f);
-    free(nodes);
-    reset_visited(v);
+    print_graph(v, filename, EXPORT_BACKWARD);
 }
 
 void value_print_full_graph(Value *v, const char *filename)
 {
-    if (!v || !filename)
-        return;
-
-    ensure_output_dir();
-    char filepath[256];
-    snprintf(filepath, sizeof(filepath), "output/%s", filename);
-
-    FILE *f = fopen(filepath, "w");
-    if (!f)
-        return;
-
-    write_graph_header(f, "Complete Computation Graph");
-
-    fprintf(f, "    compound=true;\n");
-    fprintf(f, "    splines=ortho;\n");
-    fprintf(f, "    nodesep=0.5;\n");
-    fprintf(f, "    ranksep=0.7;\n\n");
-
-    size_t node_count = 0;
-    count_nodes(v, &node_count);
-    reset_visited(v);
-
-    Value **nodes = malloc(node_count * sizeof(Value *));
-    if (!nodes)
-    {
-        fclose(f);
-        return;
-    }
-
-    size_t idx = 0;
-    build_topo(v, nodes, &idx);
-
-    if (idx != node_count)
-    {
-        free(nodes);
-        fclose(f);
-        return;
-    }
-
-    fprintf(f, "    subgraph cluster_forward {\n");
-    fprintf(f, "        style=filled;\n");
-    fprintf(f, "        fillcolor=\"#f8e8e8\";\n");
-    fprintf(f, "        color=\"#2c3e50\";\n");
-    fprintf(f, "        label=\"Computation Graph\";\n");
-    fprintf(f, "        fontsize=12;\n");
-
-    for (size_t i = 0; i < idx; i++)
-    {
-        if (nodes[i])
-        {
-            char label[100];
-            value_get_label(nodes[i], label, sizeof(label));
-            fprintf(f, "        n%p [label=\"%s\"];\n", (void *)nodes[i], label);
-        }
-    }
-    fprintf(f, "    }\n\n");
-
-    reset_visited(v);
-
-    fprintf(f, "\n    // Forward edges\n");
-    fprintf(f, "    edge [color=\"#2c3e50\", style=solid];\n");
-    for (size_t i = 0; i < idx; i++)
-    {
-        Value *node = nodes[i];
-        if (node && node->prev)
-        {
-            for (size_t j = 0; j < node->prev_count; j++)
-            {
-                if (node->prev[j])
-                {
-                    fprintf(f, "    n%p -> n%p;\n",
-                            (void *)node->prev[j], (void *)node);
-                }
-            }
-        }
-    }
-
-    fprintf(f, "\n    // Backward edges\n");
-    fprintf(f, "    edge [color=\"#e74c3c\", style=dashed];\n");
-    for (size_t i = 0; i < idx; i++)
-    {
-        Value *node = nodes[i];
-        if (node && node->prev)
-        {
-            for (size_t j = 0; j < node->prev_count; j++)
-            {
-                if (node->prev[j])
-                {
-                    fprintf(f, "    n%p -> n%p [color=\"#e74c3c\", style=dashed];\n",
-                            (void *)node, (void *)node->prev[j]);
-                }
-            }
-        }
-    }
-
-    fprintf(f, "}\n");
-    fclose(f);
-    free(nodes);
-    reset_visited(v);
+    print_graph(v, filename, EXPORT_FULL);
 }
@@ -0,0 +1,639 @@
+#include "../include/export.h"
+#include "../include/engine.h"
+#include "../include/node_map.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#define EXPORT_NONE UINT32_MAX
+#define EXPORT_MIN_BUFFER 4096
+#define EXPORT_PRINTF_RESERVE 512
+
+typedef struct
+{
+    FILE *out;
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t total;
+    int failed;
+} ExportWriter;
+
+typedef enum
+{
+    EDGES_COUNT,
+    EDGES_DOT_FORWARD,
+    EDGES_DOT_BACKWARD,
+    EDGES_JSON,
+    EDGES_BINARY
+} EdgeMode;
+
+/* Everything is indexed by topo position. The inputs of node i are
+   inputs[start[i]..start[i+1]) so later passes never touch the hash map.
+   group[i] is the topo index of the node that stands in for i (itself
+   unless i was collapsed into a chain), and id[] holds compact output ids
+   for the nodes that are emitted. */
+typedef struct
+{
+    Value **topo;
+    size_t count;
+    size_t *start;
+    uint32_t *inputs;
+    uint32_t *depth;
+    uint32_t *consumers;
+    uint32_t *group;
+    uint32_t *size;
+    uint32_t *id;
+    uint32_t *scratch;
+    uint32_t *hidden;
+    size_t emitted;
+    size_t edges;
+    int weighted;
+} ExportGraph;
+
+static void writer_flush(ExportWriter *w)
+{
+    if (w->len && fwrite(w->buf, 1, w->len, w->out) != w->len)
+        w->failed = 1;
+    w->total += w->len;
+    w->len = 0;
+}
+
+static void writer_put(ExportWriter *w, const void *data, size_t n)
+{
+    if (w->len + n > w->cap)
+    {
+        writer_flush(w);
+        if (n > w->cap)
+        {
+            if (fwrite(data, 1, n, w->out) != n)
+                w->failed = 1;
+            w->total += n;
+            return;
+        }
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void writer_str(ExportWriter *w, const char *s)
+{
+    writer_put(w, s, strlen(s));
+}
+
+static void writer_uint(ExportWriter *w, uint64_t v)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    writer_put(w, digits + sizeof(digits) - n, n);
+}
+
+static void writer_printf(ExportWriter *w, const char *fmt, ...)
+{
+    if (w->cap - w->len < EXPORT_PRINTF_RESERVE)
+        writer_flush(w);
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->len, w->cap - w->len, fmt, args);
+    va_end(args);
+    if (n < 0)
+        w->failed = 1;
+    else if ((size_t)n < w->cap - w->len)
+        w->len += n;
+}
+
+/* Same text as "%.4f" for the magnitudes graphs actually hold, without the
+   cost of a printf call per number. */
+static void writer_fixed4(ExportWriter *w, double x)
+{
+    if (!(fabs(x) < 1e14))
+    {
+        writer_printf(w, "%.4f", x);
+        return;
+    }
+
+    uint64_t scaled = (uint64_t)llround(fabs(x) * 10000.0);
+    char frac[5];
+    if (signbit(x))
+        writer_str(w, "-");
+    writer_uint(w, scaled / 10000);
+    frac[0] = '.';
+    for (int i = 4; i > 0; i--)
+    {
+        frac[i] = (char)('0' + scaled % 10);
+        scaled /= 10;
+    }
+    writer_put(w, frac, sizeof(frac));
+}
+
+static int export_collapsible(ValueOp op)
+{
+    return op != VALUE_OP_LEAF && op != VALUE_OP_TENSOR && op != VALUE_OP_CUSTOM;
+}
+
+static void export_graph_free(ExportGraph *g)
+{
+    free(g->start);
+    free(g->inputs);
+    free(g->depth);
+}
+
+/* Depth is the shortest distance from the root, found in one reverse sweep
+   because every consumer comes after its inputs in topo order. */
+static void export_depths(ExportGraph *g)
+{
+    for (size_t i = 0; i < g->count; i++)
+        g->depth[i] = EXPORT_NONE;
+    g->depth[g->count - 1] = 0;
+
+    for (size_t i = g->count; i-- > 0;)
+    {
+        for (size_t k = g->start[i]; k < g->start[i + 1]; k++)
+        {
+            uint32_t p = g->inputs[k];
+            g->consumers[p]++;
+            if (g->depth[i] != EXPORT_NONE && g->depth[i] + 1 < g->depth[p])
+                g->depth[p] = g->depth[i] + 1;
+        }
+    }
+}
+
+/* An input joins its consumer's group when it has the same op and feeds
+   nothing else, so a chain of adds (or a tree of them) becomes one node.
+   Groups smaller than collapse_min are split back into single nodes. */
+static void export_groups(ExportGraph *g, size_t collapse_min)
+{
+    for (size_t i = 0; i < g->count; i++)
+    {
+        g->group[i] = (uint32_t)i;
+        g->size[i] = 0;
+    }
+    if (collapse_min < 2)
+    {
+        for (size_t i = 0; i < g->count; i++)
+            g->size[i] = 1;
+        return;
+    }
+
+    for (size_t i = g->count; i-- > 0;)
+    {
+        ValueOp op = value_get_op(g->topo[i]);
+        if (!export_collapsible(op))
+            continue;
+        for (size_t k = g->start[i]; k < g->start[i + 1]; k++)
+        {
+            uint32_t p = g->inputs[k];
+            if (g->consumers[p] == 1 && value_get_op(g->topo[p]) == op)
+                g->group[p] = g->group[i];
+        }
+    }
+
+    for (size_t i = 0; i < g->count; i++)
+        g->size[g->group[i]]++;
+    for (size_t i = 0; i < g->count; i++)
+    {
+        if (g->size[g->group[i]] < collapse_min)
+            g->group[i] = (uint32_t)i;
+    }
+    for (size_t i = 0; i < g->count; i++)
+        g->size[i] = 0;
+    for (size_t i = 0; i < g->count; i++)
+        g->size[g->group[i]]++;
+}
+
+/* Keeps groups within max_depth, then the max_nodes groups closest to the
+   root (whole depth levels first, the last level in reverse topo order). */
+static void export_select(ExportGraph *g, const ExportOptions *o)
+{
+    size_t max_depth = o->max_depth ? o->max_depth : SIZE_MAX;
+    size_t budget = o->max_nodes ? o->max_nodes : SIZE_MAX;
+    size_t cutoff = SIZE_MAX;
+    uint32_t *per_depth = g->scratch;
+
+    for (size_t i = 0; i < g->count; i++)
+        per_depth[i] = 0;
+    for (size_t i = 0; i < g->count; i++)
+    {
+        if (g->group[i] == i && g->depth[i] <= max_depth)
+            per_depth[g->depth[i]]++;
+    }
+
+    size_t used = 0;
+    for (size_t d = 0; d < g->count && d <= max_depth; d++)
+    {
+        if (used + per_depth[d] > budget)
+        {
+            cutoff = d;
+            break;
+        }
+        used += per_depth[d];
+    }
+
+    uint32_t next = 0;
+    for (size_t i = g->count; i-- > 0;)
+    {
+        g->id[i] = EXPORT_NONE;
+        if (g->group[i] != i || g->depth[i] > max_depth || g->depth[i] > cutoff)
+            continue;
+        if (g->depth[i] == cutoff)
+        {
+            if (used == budget)
+                continue;
+            used++;
+        }
+        g->id[i] = next++;
+    }
+    g->emitted = next;
+}
+
+/* Counts the inputs of each shown group that the limits cut off. The
+   consumer counts are no longer needed once groups are settled. */
+static void export_hidden(ExportGraph *g)
+{
+    g->hidden = g->consumers;
+    memset(g->hidden, 0, g->count * sizeof(uint32_t));
+
+    for (size_t i = 0; i < g->count; i++)
+    {
+        uint32_t rep = g->group[i];
+        if (g->id[rep] == EXPORT_NONE)
+            continue;
+        for (size_t k = g->start[i]; k < g->start[i + 1]; k++)
+        {
+            uint32_t p = g->inputs[k];
+            if (g->group[p] != rep && g->id[g->group[p]] == EXPORT_NONE)
+                g->hidden[rep]++;
+        }
+    }
+}
+
+static int export_inputs(ExportGraph *g)
+{
+    NodeMap index;
+    size_t total = 0;
+    for (size_t i = 0; i < g->count; i++)
+        total += g->topo[i]->prev_count;
+
+    g->start = malloc((g->count + 1) * sizeof(size_t));
+    g->inputs = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (!g->start || !g->inputs || !node_map_init(&index, g->count))
+        return 0;
+
+    int ok = 1;
+    for (size_t i = 0; i < g->count && ok; i++)
+        ok = node_map_insert(&index, g->topo[i], i) >= 0;
+
+    size_t k = 0;
+    for (size_t i = 0; i < g->count && ok; i++)
+    {
+        Value *node = g->topo[i];
+        g->start[i] = k;
+        for (size_t j = 0; j < node->prev_count; j++)
+        {
+            size_t idx;
+            if (node->prev[j] && node_map_get(&index, node->prev[j], &idx))
+                g->inputs[k++] = (uint32_t)idx;
+        }
+    }
+    g->start[g->count] = k;
+    node_map_free(&index);
+    return ok;
+}
+
+static int export_prepare(ExportGraph *g, Value *root, const ExportOptions *o)
+{
+    memset(g, 0, sizeof(*g));
+    g->topo = value_topo(root, &g->count);
+    if (!g->topo || g->count >= EXPORT_NONE)
+        return 0;
+
+    uint32_t *arrays = malloc(6 * g->count * sizeof(uint32_t));
+    g->depth = arrays;
+    if (!arrays || !export_inputs(g))
+    {
+        export_graph_free(g);
+        return 0;
+    }
+    g->consumers = arrays + g->count;
+    g->group = arrays + 2 * g->count;
+    g->size = arrays + 3 * g->count;
+    g->id = arrays + 4 * g->count;
+    g->scratch = arrays + 5 * g->count;
+    memset(g->consumers, 0, g->count * sizeof(uint32_t));
+
+    export_depths(g);
+    export_groups(g, o->collapse_min);
+    export_select(g, o);
+    export_hidden(g);
+    return 1;
+}
+
+static void export_edge(ExportWriter *w, EdgeMode mode, uint32_t src, uint32_t dst, size_t n, int weighted)
+{
+    switch (mode)
+    {
+    case EDGES_COUNT:
+        break;
+    case EDGES_DOT_FORWARD:
+    case EDGES_DOT_BACKWARD:
+        writer_str(w, "    n");
+        writer_uint(w, mode == EDGES_DOT_FORWARD ? src : dst);
+        writer_str(w, " -> n");
+        writer_uint(w, mode == EDGES_DOT_FORWARD ? dst : src);
+        writer_str(w, weighted ? " [weight=2];\n" : ";\n");
+        break;
+    case EDGES_JSON:
+        writer_str(w, n ? ",[" : "[");
+        writer_uint(w, src);
+        writer_str(w, ",");
+        writer_uint(w, dst);
+        writer_str(w, "]");
+        break;
+    case EDGES_BINARY:
+    {
+        uint32_t pair[2] = {src, dst};
+        writer_put(w, pair, sizeof(pair));
+        break;
+    }
+    }
+}
+
+/* Edges run producer -> consumer between shown groups. Edges inside a
+   group are dropped, and scratch[] remembers the last consumer each input
+   fed so a constant shared by a whole collapsed chain is linked once. */
+static size_t export_edges(ExportGraph *g, ExportWriter *w, EdgeMode mode)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < g->count; i++)
+        g->scratch[i] = EXPORT_NONE;
+
+    for (size_t i = g->count; i-- > 0;)
+    {
+        uint32_t dst = g->group[i];
+        if (g->id[dst] == EXPORT_NONE)
+            continue;
+
+        for (size_t k = g->start[i]; k < g->start[i + 1]; k++)
+        {
+            uint32_t p = g->inputs[k];
+            uint32_t src = g->group[p];
+            if (src == dst || g->id[src] == EXPORT_NONE)
+                continue;
+            if (g->size[dst] > 1)
+            {
+                if (g->scratch[src] == dst)
+                    continue;
+                g->scratch[src] = dst;
+            }
+            export_edge(w, mode, g->id[src], g->id[dst], n++, g->weighted);
+        }
+    }
+    return n;
+}
+
+static const char *export_op_name(Value *v)
+{
+    const char *op = value_get_op_symbol(v);
+    return op[0] ? op : "leaf";
+}
+
+static void export_dot_label(ExportWriter *w, Value *v, uint32_t count, uint32_t hidden, int with_grad)
+{
+    const char *op = value_get_op_symbol(v);
+    writer_str(w, "{");
+    if (op[0])
+    {
+        writer_str(w, op);
+        if (count > 1)
+        {
+            writer_str(w, " x");
+            writer_uint(w, count);
+        }
+        writer_str(w, " | ");
+    }
+    writer_str(w, "data ");
+    writer_fixed4(w, v->data);
+    if (with_grad)
+    {
+        writer_str(w, " | grad ");
+        writer_fixed4(w, v->grad);
+    }
+    if (hidden)
+    {
+        writer_str(w, " | +");
+        writer_uint(w, hidden);
+        writer_str(w, " hidden inputs");
+    }
+    writer_str(w, "}");
+}
+
+static void export_dot(ExportGraph *g, ExportWriter *w, ExportView view)
+{
+    static const char *titles[] = {"Forward Computation Graph", "Backward Computation Graph",
+                                   "Complete Computation Graph"};
+    static const char *clusters[] = {"Forward Pass", "Backward Pass", "Computation Graph"};
+
+    writer_str(w, "digraph G {\n"
+                  "    rankdir=LR;\n"
+                  "    bgcolor=\"#ffffff\";\n");
+    writer_printf(w, "    title=\"%s\";\n", titles[view]);
+    writer_str(w, "    node [shape=record, style=filled, fillcolor=\"#f8e8e8\", fontsize=10];\n"
+                  "    edge [color=\"#2c3e50\"];\n\n"
+                  "    compound=true;\n"
+                  "    splines=ortho;\n"
+                  "    nodesep=0.5;\n"
+                  "    ranksep=0.7;\n\n"
+                  "    subgraph cluster_0 {\n"
+                  "        style=filled;\n"
+                  "        fillcolor=\"#f8e8e8\";\n"
+                  "        color=\"#2c3e50\";\n");
+    writer_printf(w, "        label=\"%s\";\n", clusters[view]);
+    writer_str(w, "        fontsize=12;\n");
+
+    if (view != EXPORT_FULL)
+    {
+        writer_str(w, "        { rank=same; ");
+        for (size_t i = g->count; i-- > 0;)
+        {
+            if (g->id[i] != EXPORT_NONE && g->topo[i]->prev_count == 0)
+            {
+                writer_str(w, "n");
+                writer_uint(w, g->id[i]);
+                writer_str(w, "; ");
+            }
+        }
+        writer_str(w, "}\n");
+    }
+
+    for (size_t i = g->count; i-- > 0;)
+    {
+        if (g->id[i] == EXPORT_NONE)
+            continue;
+        writer_str(w, "        n");
+        writer_uint(w, g->id[i]);
+        writer_str(w, " [label=\"");
+        export_dot_label(w, g->topo[i], g->size[i], g->hidden[i], view != EXPORT_FORWARD);
+        writer_str(w, "\"];\n");
+    }
+    writer_str(w, "    }\n\n");
+
+    g->weighted = view != EXPORT_FULL;
+    g->edges = 0;
+    if (view != EXPORT_BACKWARD)
+    {
+        writer_str(w, "    // Forward edges\n    edge [color=\"#2c3e50\", style=solid];\n");
+        g->edges += export_edges(g, w, EDGES_DOT_FORWARD);
+    }
+    if (view != EXPORT_FORWARD)
+    {
+        writer_str(w, "\n    // Backward edges\n    edge [color=\"#e74c3c\", style=dashed];\n");
+        g->edges += export_edges(g, w, EDGES_DOT_BACKWARD);
+    }
+    writer_str(w, "}\n");
+}
+
+static void export_json_number(ExportWriter *w, double x)
+{
+    if (isfinite(x))
+        writer_printf(w, "%.17g", x);
+    else
+        writer_str(w, "null");
+}
+
+static void export_json(ExportGraph *g, ExportWriter *w)
+{
+    writer_str(w, "{\"root\": 0, \"nodes\": [\n");
+    for (size_t i = g->count; i-- > 0;)
+    {
+        if (g->id[i] == EXPORT_NONE)
+            continue;
+        Value *v = g->topo[i];
+        writer_str(w, g->id[i] ? ",\n  {\"id\": " : "  {\"id\": ");
+        writer_uint(w, g->id[i]);
+        writer_str(w, ", \"op\": \"");
+        writer_str(w, export_op_name(v));
+        writer_str(w, (v->flags & VALUE_FLAG_TENSOR) ? "\", \"tensor\": true, \"data\": " : "\", \"data\": ");
+        export_json_number(w, v->data);
+        writer_str(w, ", \"grad\": ");
+        export_json_number(w, v->grad);
+        writer_str(w, ", \"count\": ");
+        writer_uint(w, g->size[i]);
+        writer_str(w, ", \"hidden_inputs\": ");
+        writer_uint(w, g->hidden[i]);
+        writer_str(w, "}");
+    }
+    writer_str(w, "\n], \"edges\": [");
+    g->edges = export_edges(g, w, EDGES_JSON);
+    writer_str(w, "]}\n");
+}
+
+static void export_binary(ExportGraph *g, ExportWriter *w)
+{
+    ExportBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXPORT_BINARY_MAGIC, sizeof(EXPORT_BINARY_MAGIC));
+    header.version = EXPORT_BINARY_VERSION;
+    header.root = 0;
+    header.node_count = g->emitted;
+    header.edge_count = export_edges(g, w, EDGES_COUNT);
+    writer_put(w, &header, sizeof(header));
+
+    for (size_t i = g->count; i-- > 0;)
+    {
+        if (g->id[i] == EXPORT_NONE)
+            continue;
+        ExportBinaryNode node = {g->topo[i]->data, g->topo[i]->grad, (uint32_t)value_get_op(g->topo[i]),
+                                 g->size[i], g->hidden[i], 0};
+        writer_put(w, &node, sizeof(node));
+    }
+    g->edges = export_edges(g, w, EDGES_BINARY);
+}
+
+ExportOptions export_options(ExportFormat format, ExportView view)
+{
+    return (ExportOptions){format, view, 0, 0, 0, EXPORT_DEFAULT_BUFFER};
+}
+
+int value_export(Value *root, FILE *out, const ExportOptions *options, ExportStats *stats)
+{
+    if (!root || !out || !options)
+    {
+        fprintf(stderr, "[ERROR] Invalid arguments to value_export\n");
+        return 0;
+    }
+
+    ExportGraph g;
+    if (!export_prepare(&g, root, options))
+    {
+        fprintf(stderr, "[ERROR] Failed to prepare graph for export\n");
+        return 0;
+    }
+
+    ExportWriter w = {out, NULL, 0, options->buffer_size, 0, 0};
+    if (w.cap < EXPORT_MIN_BUFFER)
+        w.cap = EXPORT_MIN_BUFFER;
+    w.buf = malloc(w.cap);
+    if (!w.buf)
+    {
+        fprintf(stderr, "[ERROR] Memory allocation failed for export buffer\n");
+        export_graph_free(&g);
+        return 0;
+    }
+
+    switch (options->format)
+    {
+    case EXPORT_DOT:
+        export_dot(&g, &w, options->view);
+        break;
+    case EXPORT_JSON:
+        export_json(&g, &w);
+        break;
+    case EXPORT_BINARY:
+        export_binary(&g, &w);
+        break;
+    }
+    writer_flush(&w);
+
+    if (stats)
+    {
+        size_t reps = 0;
+        for (size_t i = 0; i < g.count; i++)
+            reps += g.group[i] == i;
+        stats->nodes = g.emitted;
+        stats->edges = g.edges;
+        stats->hidden = reps - g.emitted;
+        stats->collapsed = g.count - reps;
+        stats->bytes = w.total;
+    }
+
+    free(w.buf);
+    export_graph_free(&g);
+    if (w.failed)
+        fprintf(stderr, "[ERROR] Failed to write graph export\n");
+    return !w.failed;
+}
+
+int value_export_file(Value *root, const char *path, const ExportOptions *options, ExportStats *stats)
+{
+    if (!path)
+        return 0;
+
+    FILE *f = fopen(path, options && options->format == EXPORT_BINARY ? "wb" : "w");
+    if (!f)
+    {
+        fprintf(stderr, "[ERROR] Could not open %s for writing\n", path);
+        return 0;
+    }
+
+    int ok = value_export(root, f, options, stats);
+    if (fclose(f) != 0)
+        ok = 0;
+    return ok;
+}
@@ -0,0 +1,360 @@
+#include "../include/fuse.h"
+#include "../include/profile.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+void fused_kernel_init(FusedKernel *k)
+{
+    memset(k, 0, sizeof(*k));
+}
+
+static int fused_input_slot(const FusedKernel *k, int reg)
+{
+    return k->code[reg].op == FUSE_INPUT ? k->code[reg].a : -1;
+}
+
+/* Recognises act(a op b) and act(a * b +/- c) over input registers, with
+   act one of identity, ReLU or tanh, computed in the last register. Those
+   kernels get straight-line forward and backward code instead of the
+   interpreter. */
+static void fused_classify(FusedKernel *k)
+{
+    int ops[FUSE_MAX_CODE], m = 0;
+    k->shape = FUSE_SHAPE_GENERIC;
+    k->act = FUSE_INPUT;
+    for (int i = 0; i < k->count; i++)
+    {
+        if (k->code[i].op == FUSE_CONST)
+            return;
+        if (k->code[i].op != FUSE_INPUT)
+            ops[m++] = i;
+    }
+    if (m == 0 || m > 3 || ops[m - 1] != k->count - 1)
+        return;
+
+    const FuseInstr *last = &k->code[ops[m - 1]];
+    if (last->op == FUSE_RELU || last->op == FUSE_TANH)
+    {
+        if (m == 1 || last->a != ops[m - 2])
+            return;
+        k->act = last->op;
+        m--;
+    }
+
+    const FuseInstr *first = &k->code[ops[0]];
+    int a = fused_input_slot(k, first->a), b = fused_input_slot(k, first->b);
+    if (a < 0 || b < 0)
+        return;
+
+    if (m == 1 && (first->op == FUSE_ADD || first->op == FUSE_SUB || first->op == FUSE_MUL))
+    {
+        k->shape = FUSE_SHAPE_BINARY;
+        k->op = first->op;
+        k->slot[0] = a;
+        k->slot[1] = b;
+    }
+    else if (m == 2 && first->op == FUSE_MUL)
+    {
+        const FuseInstr *second = &k->code[ops[1]];
+        int c = second->a == ops[0] ? fused_input_slot(k, second->b) : -1;
+        if (second->op == FUSE_ADD && c < 0 && second->b == ops[0])
+            c = fused_input_slot(k, second->a);
+        if (c < 0 || (second->op != FUSE_ADD && second->op != FUSE_SUB))
+            return;
+        k->shape = second->op == FUSE_ADD ? FUSE_SHAPE_MUL_ADD : FUSE_SHAPE_MUL_SUB;
+        k->slot[0] = a;
+        k->slot[1] = b;
+        k->slot[2] = c;
+    }
+}
+
+/* Registers are SSA: instruction i writes register i and may only read
+   registers written before it. */
+static int fused_emit(FusedKernel *k, FuseOp op, int operands, int a, int b, double value)
+{
+    if (k->failed)
+        return -1;
+    if (k->count >= FUSE_MAX_CODE || (operands > 0 && (a < 0 || a >= k->count)) ||
+        (operands > 1 && (b < 0 || b >= k->count)))
+    {
+        fprintf(stderr, "[ERROR] Invalid fused kernel instruction %d\n", k->count);
+        k->failed = 1;
+        return -1;
+    }
+
+    k->code[k->count] = (FuseInstr){op, operands > 0 ? a : 0, operands > 1 ? b : 0, value};
+    k->count++;
+    fused_classify(k);
+    return k->count - 1;
+}
+
+int fused_input(FusedKernel *k)
+{
+    if (k->inputs >= FUSE_MAX_INPUTS)
+    {
+        fprintf(stderr, "[ERROR] Fused kernel has more than %d inputs\n", FUSE_MAX_INPUTS);
+        k->failed = 1;
+        return -1;
+    }
+    int reg = fused_emit(k, FUSE_INPUT, 0, 0, 0, 0.0);
+    if (reg >= 0)
+    {
+        k->code[reg].a = k->inputs++;
+        fused_classify(k);
+    }
+    return reg;
+}
+
+int fused_const(FusedKernel *k, double value)
+{
+    return fused_emit(k, FUSE_CONST, 0, 0, 0, value);
+}
+
+int fused_add(FusedKernel *k, int a, int b)
+{
+    return fused_emit(k, FUSE_ADD, 2, a, b, 0.0);
+}
+
+int fused_sub(FusedKernel *k, int a, int b)
+{
+    return fused_emit(k, FUSE_SUB, 2, a, b, 0.0);
+}
+
+int fused_mul(FusedKernel *k, int a, int b)
+{
+    return fused_emit(k, FUSE_MUL, 2, a, b, 0.0);
+}
+
+int fused_div(FusedKernel *k, int a, int b)
+{
+    return fused_emit(k, FUSE_DIV, 2, a, b, 0.0);
+}
+
+int fused_pow(FusedKernel *k, int base, double exponent)
+{
+    return fused_emit(k, FUSE_POW, 1, base, 0, exponent);
+}
+
+int fused_relu(FusedKernel *k, int x)
+{
+    return fused_emit(k, FUSE_RELU, 1, x, 0, 0.0);
+}
+
+int fused_tanh(FusedKernel *k, int x)
+{
+    return fused_emit(k, FUSE_TANH, 1, x, 0, 0.0);
+}
+
+static void fused_run(const FusedKernel *k, const double *inputs, double *regs, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const FuseInstr *in = &k->code[i];
+        switch (in->op)
+        {
+        case FUSE_INPUT:
+            regs[i] = inputs[in->a];
+            break;
+        case FUSE_CONST:
+            regs[i] = in->k;
+            break;
+        case FUSE_ADD:
+            regs[i] = regs[in->a] + regs[in->b];
+            break;
+        case FUSE_SUB:
+            regs[i] = regs[in->a] - regs[in->b];
+            break;
+        case FUSE_MUL:
+            regs[i] = regs[in->a] * regs[in->b];
+            break;
+        case FUSE_DIV:
+            regs[i] = regs[in->a] / regs[in->b];
+            break;
+        case FUSE_POW:
+            regs[i] = pow(regs[in->a], in->k);
+            break;
+        case FUSE_RELU:
+            regs[i] = regs[in->a] > 0 ? regs[in->a] : 0;
+            break;
+        case FUSE_TANH:
+            regs[i] = tanh(regs[in->a]);
+            break;
+        }
+    }
+}
+
+double fused_forward(const FusedKernel *k, const double *inputs, double *regs)
+{
+    double x;
+    switch (k->shape)
+    {
+    case FUSE_SHAPE_BINARY:
+    {
+        double a = inputs[k->slot[0]], b = inputs[k->slot[1]];
+        x = k->op == FUSE_ADD ? a + b : k->op == FUSE_SUB ? a - b : a * b;
+        break;
+    }
+    case FUSE_SHAPE_MUL_ADD:
+        x = inputs[k->slot[0]] * inputs[k->slot[1]] + inputs[k->slot[2]];
+        break;
+    case FUSE_SHAPE_MUL_SUB:
+        x = inputs[k->slot[0]] * inputs[k->slot[1]] - inputs[k->slot[2]];
+        break;
+    default:
+        fused_run(k, inputs, regs, k->count);
+        return regs[k->count - 1];
+    }
+
+    if (k->act == FUSE_TANH)
+        return tanh(x);
+    if (k->act == FUSE_RELU)
+        return x > 0 ? x : 0;
+    return x;
+}
+
+static void fused_backward_shaped(const FusedKernel *k, const double *inputs, double out, double grad,
+                                  double *input_grads)
+{
+    double d = grad;
+    if (k->act == FUSE_TANH)
+        d *= 1 - out * out;
+    else if (k->act == FUSE_RELU)
+        d = out > 0 ? d : 0;
+
+    int a = k->slot[0], b = k->slot[1];
+    if (k->shape == FUSE_SHAPE_BINARY && k->op != FUSE_MUL)
+    {
+        input_grads[a] += d;
+        input_grads[b] += k->op == FUSE_ADD ? d : -d;
+        return;
+    }
+
+    input_grads[a] += inputs[b] * d;
+    input_grads[b] += inputs[a] * d;
+    if (k->shape == FUSE_SHAPE_MUL_ADD)
+        input_grads[k->slot[2]] += d;
+    else if (k->shape == FUSE_SHAPE_MUL_SUB)
+        input_grads[k->slot[2]] -= d;
+}
+
+/* Recomputes the intermediate registers, taking the result from out so a
+   trailing tanh or pow is not evaluated again, then sweeps them in
+   reverse. Input adjoints are added into input_grads. */
+void fused_backward(const FusedKernel *k, const double *inputs, double out, double grad, double *input_grads)
+{
+    if (k->shape != FUSE_SHAPE_GENERIC)
+    {
+        fused_backward_shaped(k, inputs, out, grad, input_grads);
+        return;
+    }
+
+    double regs[FUSE_MAX_CODE], adj[FUSE_MAX_CODE];
+    fused_run(k, inputs, regs, k->count - 1);
+    regs[k->count - 1] = out;
+    for (int i = 0; i < k->count - 1; i++)
+        adj[i] = 0.0;
+    adj[k->count - 1] = grad;
+
+    for (int i = k->count; i-- > 0;)
+    {
+        const FuseInstr *in = &k->code[i];
+        double g = adj[i];
+        switch (in->op)
+        {
+        case FUSE_INPUT:
+            input_grads[in->a] += g;
+            break;
+        case FUSE_CONST:
+            break;
+        case FUSE_ADD:
+            adj[in->a] += g;
+            adj[in->b] += g;
+            break;
+        case FUSE_SUB:
+            adj[in->a] += g;
+            adj[in->b] -= g;
+            break;
+        case FUSE_MUL:
+            adj[in->a] += regs[in->b] * g;
+            adj[in->b] += regs[in->a] * g;
+            break;
+        case FUSE_DIV:
+        {
+            double b = regs[in->b];
+            if (b == 0)
+            {
+                fprintf(stderr, "[ERROR] Division by zero in fused_backward\n");
+                break;
+            }
+            adj[in->a] += g / b;
+            adj[in->b] -= g * regs[in->a] / (b * b);
+            break;
+        }
+        case FUSE_POW:
+            adj[in->a] += in->k * pow(regs[in->a], in->k - 1) * g;
+            break;
+        case FUSE_RELU:
+            adj[in->a] += regs[in->a] > 0 ? g : 0;
+            break;
+        case FUSE_TANH:
+            adj[in->a] += (1 - regs[i] * regs[i]) * g;
+            break;
+        }
+    }
+}
+
+void backward_fused(Value *self)
+{
+    const FusedKernel *k = *(const FusedKernel **)self->backward_ctx;
+    double inputs[FUSE_MAX_INPUTS], grads[FUSE_MAX_INPUTS];
+
+    for (int i = 0; i < k->inputs; i++)
+    {
+        inputs[i] = self->prev[i]->data;
+        grads[i] = 0.0;
+    }
+    fused_backward(k, inputs, self->data, self->grad, grads);
+
+    for (int i = 0; i < k->inputs; i++)
+        value_grad_add(&self->prev[i]->grad, grads[i]);
+}
+
+static Value *build_fused(const FusedKernel *k, Value **inputs)
+{
+    double data[FUSE_MAX_INPUTS], regs[FUSE_MAX_CODE];
+    int lazy = k->inputs > 0 && value_defer(inputs, k->inputs);
+    for (int i = 0; i < k->inputs && !lazy; i++)
+        data[i] = inputs[i]->data;
+
+    Value *out = value_create(lazy ? NAN : fused_forward(k, data, regs));
+    if (!out || !value_grad_enabled() || k->inputs == 0)
+        return out;
+
+    const FusedKernel **ctx = value_alloc_ctx(out, sizeof(*ctx));
+    if (!ctx || !value_alloc_prev(out, k->inputs))
+    {
+        value_free(out);
+        return NULL;
+    }
+    *ctx = k;
+    memcpy(out->prev, inputs, k->inputs * sizeof(Value *));
+    out->backward = backward_fused;
+    if (lazy)
+        out->flags |= VALUE_FLAG_LAZY;
+    return out;
+}
+
+Value *value_fused(const FusedKernel *k, Value **inputs)
+{
+    if (!k || k->failed || k->count == 0 || (k->inputs && !inputs))
+    {
+        fprintf(stderr, "[ERROR] Invalid fused kernel in value_fused\n");
+        return NULL;
+    }
+
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_fused(k, inputs);
+    PROFILE_FORWARD_END("fused", 1);
+    return out;
+}
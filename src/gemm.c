@@ -0,0 +1,407 @@
+#include "../include/gemm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_X86 1
+#endif
+
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4096
+#define GEMM_MR_MAX 8
+#ifdef GIGAGRAD_FLOAT32
+#define GEMM_NR_MAX 32
+#define GEMM_AVX2_NR 16
+#define GEMM_AVX512_NR 32
+#else
+#define GEMM_NR_MAX 16
+#define GEMM_AVX2_NR 8
+#define GEMM_AVX512_NR 16
+#endif
+
+typedef void (*GemmMicroKernel)(size_t kc, const real_t *pa, const real_t *pb,
+                                real_t *c, size_t ldc);
+
+typedef struct
+{
+    const char *name;
+    size_t mr;
+    size_t nr;
+    GemmMicroKernel kernel;
+} GemmKernel;
+
+static void gemm_kernel_scalar(size_t kc, const real_t *pa, const real_t *pb,
+                               real_t *c, size_t ldc)
+{
+    real_t acc[4][4] = {{0}};
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        for (size_t r = 0; r < 4; r++)
+        {
+            real_t a = pa[p * 4 + r];
+            for (size_t j = 0; j < 4; j++)
+                acc[r][j] += a * pb[p * 4 + j];
+        }
+    }
+
+    for (size_t r = 0; r < 4; r++)
+    {
+        for (size_t j = 0; j < 4; j++)
+            c[r * ldc + j] += acc[r][j];
+    }
+}
+
+#if defined(GEMM_X86) && defined(GIGAGRAD_FLOAT32)
+__attribute__((target("avx2,fma"))) static void gemm_kernel_avx2(size_t kc, const float *pa, const float *pb,
+                                                                  float *c, size_t ldc)
+{
+    __m256 acc[6][2];
+#pragma GCC unroll 6
+    for (int r = 0; r < 6; r++)
+    {
+        acc[r][0] = _mm256_setzero_ps();
+        acc[r][1] = _mm256_setzero_ps();
+    }
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        __m256 b0 = _mm256_loadu_ps(pb);
+        __m256 b1 = _mm256_loadu_ps(pb + 8);
+#pragma GCC unroll 6
+        for (int r = 0; r < 6; r++)
+        {
+            __m256 a = _mm256_broadcast_ss(pa + r);
+            acc[r][0] = _mm256_fmadd_ps(a, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(a, b1, acc[r][1]);
+        }
+        pa += 6;
+        pb += 16;
+    }
+
+#pragma GCC unroll 6
+    for (int r = 0; r < 6; r++)
+    {
+        float *row = c + r * ldc;
+        _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[r][0]));
+        _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[r][1]));
+    }
+}
+
+__attribute__((target("avx512f"))) static void gemm_kernel_avx512(size_t kc, const float *pa, const float *pb,
+                                                                   float *c, size_t ldc)
+{
+    __m512 acc[8][2];
+#pragma GCC unroll 8
+    for (int r = 0; r < 8; r++)
+    {
+        acc[r][0] = _mm512_setzero_ps();
+        acc[r][1] = _mm512_setzero_ps();
+    }
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        __m512 b0 = _mm512_loadu_ps(pb);
+        __m512 b1 = _mm512_loadu_ps(pb + 16);
+#pragma GCC unroll 8
+        for (int r = 0; r < 8; r++)
+        {
+            __m512 a = _mm512_set1_ps(pa[r]);
+            acc[r][0] = _mm512_fmadd_ps(a, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(a, b1, acc[r][1]);
+        }
+        pa += 8;
+        pb += 32;
+    }
+
+#pragma GCC unroll 8
+    for (int r = 0; r < 8; r++)
+    {
+        float *row = c + r * ldc;
+        _mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[r][0]));
+        _mm512_storeu_ps(row + 16, _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[r][1]));
+    }
+}
+#elif defined(GEMM_X86)
+__attribute__((target("avx2,fma"))) static void gemm_kernel_avx2(size_t kc, const double *pa, const double *pb,
+                                                                  double *c, size_t ldc)
+{
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        __m256d b0 = _mm256_loadu_pd(pb);
+        __m256d b1 = _mm256_loadu_pd(pb + 4);
+        __m256d a;
+
+        a = _mm256_broadcast_sd(pa + 0);
+        c00 = _mm256_fmadd_pd(a, b0, c00);
+        c01 = _mm256_fmadd_pd(a, b1, c01);
+        a = _mm256_broadcast_sd(pa + 1);
+        c10 = _mm256_fmadd_pd(a, b0, c10);
+        c11 = _mm256_fmadd_pd(a, b1, c11);
+        a = _mm256_broadcast_sd(pa + 2);
+        c20 = _mm256_fmadd_pd(a, b0, c20);
+        c21 = _mm256_fmadd_pd(a, b1, c21);
+        a = _mm256_broadcast_sd(pa + 3);
+        c30 = _mm256_fmadd_pd(a, b0, c30);
+        c31 = _mm256_fmadd_pd(a, b1, c31);
+        a = _mm256_broadcast_sd(pa + 4);
+        c40 = _mm256_fmadd_pd(a, b0, c40);
+        c41 = _mm256_fmadd_pd(a, b1, c41);
+        a = _mm256_broadcast_sd(pa + 5);
+        c50 = _mm256_fmadd_pd(a, b0, c50);
+        c51 = _mm256_fmadd_pd(a, b1, c51);
+
+        pa += 6;
+        pb += 8;
+    }
+
+#define GEMM_AVX2_STORE(row, lo, hi)                                                 \
+    _mm256_storeu_pd(c + (row) * ldc, _mm256_add_pd(_mm256_loadu_pd(c + (row) * ldc), lo)); \
+    _mm256_storeu_pd(c + (row) * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(c + (row) * ldc + 4), hi))
+
+    GEMM_AVX2_STORE(0, c00, c01);
+    GEMM_AVX2_STORE(1, c10, c11);
+    GEMM_AVX2_STORE(2, c20, c21);
+    GEMM_AVX2_STORE(3, c30, c31);
+    GEMM_AVX2_STORE(4, c40, c41);
+    GEMM_AVX2_STORE(5, c50, c51);
+
+#undef GEMM_AVX2_STORE
+}
+
+__attribute__((target("avx512f"))) static void gemm_kernel_avx512(size_t kc, const double *pa, const double *pb,
+                                                                   double *c, size_t ldc)
+{
+    __m512d acc[8][2];
+#pragma GCC unroll 8
+    for (int r = 0; r < 8; r++)
+    {
+        acc[r][0] = _mm512_setzero_pd();
+        acc[r][1] = _mm512_setzero_pd();
+    }
+
+    for (size_t p = 0; p < kc; p++)
+    {
+        __m512d b0 = _mm512_loadu_pd(pb);
+        __m512d b1 = _mm512_loadu_pd(pb + 8);
+#pragma GCC unroll 8
+        for (int r = 0; r < 8; r++)
+        {
+            __m512d a = _mm512_set1_pd(pa[r]);
+            acc[r][0] = _mm512_fmadd_pd(a, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_pd(a, b1, acc[r][1]);
+        }
+        pa += 8;
+        pb += 16;
+    }
+
+#pragma GCC unroll 8
+    for (int r = 0; r < 8; r++)
+    {
+        double *row = c + r * ldc;
+        _mm512_storeu_pd(row, _mm512_add_pd(_mm512_loadu_pd(row), acc[r][0]));
+        _mm512_storeu_pd(row + 8, _mm512_add_pd(_mm512_loadu_pd(row + 8), acc[r][1]));
+    }
+}
+#endif
+
+static const GemmKernel gemm_kernels[] = {
+    [GEMM_ISA_SCALAR] = {"scalar", 4, 4, gemm_kernel_scalar},
+#ifdef GEMM_X86
+    [GEMM_ISA_AVX2] = {"avx2", 6, GEMM_AVX2_NR, gemm_kernel_avx2},
+    [GEMM_ISA_AVX512] = {"avx512", 8, GEMM_AVX512_NR, gemm_kernel_avx512},
+#endif
+};
+
+static _Atomic(const GemmKernel *) active_kernel = NULL;
+
+static int gemm_isa_supported(GemmIsa isa)
+{
+    switch (isa)
+    {
+    case GEMM_ISA_SCALAR:
+        return 1;
+#ifdef GEMM_X86
+    case GEMM_ISA_AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case GEMM_ISA_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return 0;
+    }
+}
+
+static const GemmKernel *gemm_select(GemmIsa isa)
+{
+    if (isa == GEMM_ISA_AUTO)
+    {
+        if (gemm_isa_supported(GEMM_ISA_AVX512))
+            isa = GEMM_ISA_AVX512;
+        else if (gemm_isa_supported(GEMM_ISA_AVX2))
+            isa = GEMM_ISA_AVX2;
+        else
+            isa = GEMM_ISA_SCALAR;
+    }
+
+    return gemm_isa_supported(isa) ? &gemm_kernels[isa] : NULL;
+}
+
+int gemm_set_isa(GemmIsa isa)
+{
+    const GemmKernel *kern = gemm_select(isa);
+    if (!kern)
+        return 0;
+
+    atomic_store(&active_kernel, kern);
+    return 1;
+}
+
+/* The first GEMM may run on several workers at once. Whoever installs the
+   auto-detected kernel first wins, and an explicit gemm_set_isa is never
+   overwritten by a late auto-detect. */
+static const GemmKernel *gemm_kernel(void)
+{
+    const GemmKernel *kern = atomic_load(&active_kernel);
+    if (kern)
+        return kern;
+
+    const GemmKernel *detected = gemm_select(GEMM_ISA_AUTO);
+    if (atomic_compare_exchange_strong(&active_kernel, &kern, detected))
+        return detected;
+    return kern;
+}
+
+const char *gemm_isa_name(void)
+{
+    return gemm_kernel()->name;
+}
+
+#define GEMM_ROUND_UP(x, m) ((((x) + (m) - 1) / (m)) * (m))
+
+static real_t *gemm_alloc_panel(size_t count)
+{
+    return aligned_alloc(64, GEMM_ROUND_UP(count * sizeof(real_t), 64));
+}
+
+static void pack_a(int trans, const real_t *a, size_t lda, size_t row0, size_t rows,
+                   size_t col0, size_t cols, size_t mr, real_t *pa)
+{
+    for (size_t s = 0; s < rows; s += mr)
+    {
+        for (size_t p = 0; p < cols; p++)
+        {
+            for (size_t r = 0; r < mr; r++)
+            {
+                size_t i = row0 + s + r;
+                size_t j = col0 + p;
+                *pa++ = (s + r < rows) ? (trans ? a[j * lda + i] : a[i * lda + j]) : 0.0;
+            }
+        }
+    }
+}
+
+static void pack_b(int trans, const real_t *b, size_t ldb, size_t row0, size_t rows,
+                   size_t col0, size_t cols, size_t nr, real_t *pb)
+{
+    for (size_t s = 0; s < cols; s += nr)
+    {
+        for (size_t p = 0; p < rows; p++)
+        {
+            size_t i = row0 + p;
+            for (size_t c = 0; c < nr; c++)
+            {
+                size_t j = col0 + s + c;
+                *pb++ = (s + c < cols) ? (trans ? b[j * ldb + i] : b[i * ldb + j]) : 0.0;
+            }
+        }
+    }
+}
+
+int gemm(int trans_a, int trans_b, size_t m, size_t n, size_t k,
+         const real_t *a, size_t lda, const real_t *b, size_t ldb,
+         real_t *c, size_t ldc, int accumulate)
+{
+    if (!accumulate)
+    {
+        for (size_t i = 0; i < m; i++)
+            memset(c + i * ldc, 0, n * sizeof(real_t));
+    }
+    if (m == 0 || n == 0 || k == 0)
+        return 1;
+
+    const GemmKernel *kern = gemm_kernel();
+    size_t mr = kern->mr, nr = kern->nr;
+
+    size_t kc_max = k < GEMM_KC ? k : GEMM_KC;
+    size_t mc_max = m < GEMM_MC ? m : GEMM_MC;
+    size_t nc_max = n < GEMM_NC ? n : GEMM_NC;
+    real_t *pa = gemm_alloc_panel(GEMM_ROUND_UP(mc_max, mr) * kc_max);
+    real_t *pb = gemm_alloc_panel(GEMM_ROUND_UP(nc_max, nr) * kc_max);
+    if (!pa || !pb)
+    {
+        fprintf(stderr, "[ERROR] Memory allocation failed in gemm\n");
+        free(pa);
+        free(pb);
+        return 0;
+    }
+
+    real_t tile[GEMM_MR_MAX * GEMM_NR_MAX];
+
+    for (size_t jc = 0; jc < n; jc += GEMM_NC)
+    {
+        size_t nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+        for (size_t pc = 0; pc < k; pc += GEMM_KC)
+        {
+            size_t kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+            pack_b(trans_b, b, ldb, pc, kc, jc, nc, nr, pb);
+
+            for (size_t ic = 0; ic < m; ic += GEMM_MC)
+            {
+                size_t mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+                pack_a(trans_a, a, lda, ic, mc, pc, kc, mr, pa);
+
+                for (size_t jr = 0; jr < nc; jr += nr)
+                {
+                    size_t cols = nc - jr < nr ? nc - jr : nr;
+                    for (size_t ir = 0; ir < mc; ir += mr)
+                    {
+                        size_t rows = mc - ir < mr ? mc - ir : mr;
+                        real_t *ct = c + (ic + ir) * ldc + jc + jr;
+                        const real_t *pa_s = pa + ir * kc;
+                        const real_t *pb_s = pb + jr * kc;
+
+                        if (rows == mr && cols == nr)
+                        {
+                            kern->kernel(kc, pa_s, pb_s, ct, ldc);
+                            continue;
+                        }
+
+                        memset(tile, 0, sizeof(tile));
+                        kern->kernel(kc, pa_s, pb_s, tile, nr);
+                        for (size_t r = 0; r < rows; r++)
+                        {
+                            for (size_t j = 0; j < cols; j++)
+                                ct[r * ldc + j] += tile[r * nr + j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    free(pa);
+    free(pb);
+    return 1;
+}
@@ -0,0 +1,969 @@
+#include "../include/graph.h"
+#include "../include/engine.h"
+#include "../include/node_map.h"
+#include "../include/fuse.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define GRAPH_NO_SLOT UINT32_MAX
+
+typedef struct
+{
+    uint8_t op;
+    uint32_t begin;
+    uint32_t end;
+} GraphRun;
+
+struct Graph
+{
+    uint32_t node_count;
+    uint32_t leaf_nodes;
+    double *data;
+    double *grad;
+    uint8_t *ops;
+    uint32_t *lhs;
+    uint32_t *rhs;
+    double *params;
+    double *aux;
+    const FusedKernel **kernels;
+
+    size_t arg_total;
+    uint32_t *args;
+
+    size_t run_count;
+    GraphRun *runs;
+
+    size_t leaf_count;
+    Value **leaves;
+    uint32_t *leaf_slots;
+
+    size_t output_count;
+    uint32_t *output_slots;
+
+    uint32_t root;
+    uint32_t label_node;
+};
+
+typedef struct
+{
+    NodeMap index;
+    uint8_t *op;
+    uint32_t *level;
+    uint32_t *order;
+    uint32_t *ids;
+} GraphBuilder;
+
+static _Thread_local const GraphBuilder *sort_builder;
+
+static void graph_release(Graph *graph)
+{
+    free(graph->data);
+    free(graph->grad);
+    free(graph->ops);
+    free(graph->lhs);
+    free(graph->rhs);
+    free(graph->params);
+    free(graph->aux);
+    free(graph->kernels);
+    free(graph->args);
+    free(graph->runs);
+    free(graph->leaves);
+    free(graph->leaf_slots);
+    free(graph->output_slots);
+}
+
+void graph_free(Graph *graph)
+{
+    if (!graph)
+        return;
+
+    graph_release(graph);
+    free(graph);
+}
+
+static void graph_builder_free(GraphBuilder *b)
+{
+    node_map_free(&b->index);
+    free(b->op);
+    free(b->level);
+    free(b->order);
+    free(b->ids);
+}
+
+static int graph_alloc(Graph *graph)
+{
+    size_t n = graph->node_count;
+
+    graph->data = malloc(n * sizeof(double));
+    graph->grad = malloc(n * sizeof(double));
+    graph->ops = malloc(n * sizeof(uint8_t));
+    graph->lhs = calloc(n, sizeof(uint32_t));
+    graph->rhs = calloc(n, sizeof(uint32_t));
+    graph->params = calloc(n, sizeof(double));
+    graph->aux = calloc(n, sizeof(double));
+    graph->kernels = calloc(n, sizeof(const FusedKernel *));
+    graph->args = malloc((graph->arg_total ? graph->arg_total : 1) * sizeof(uint32_t));
+    graph->runs = malloc(n * sizeof(GraphRun));
+    graph->leaves = malloc((graph->leaf_count ? graph->leaf_count : 1) * sizeof(Value *));
+    graph->leaf_slots = malloc((graph->leaf_count ? graph->leaf_count : 1) * sizeof(uint32_t));
+    graph->output_slots = malloc((graph->output_count ? graph->output_count : 1) * sizeof(uint32_t));
+
+    return graph->data && graph->grad && graph->ops && graph->lhs && graph->rhs &&
+           graph->params && graph->aux && graph->kernels && graph->args && graph->runs &&
+           graph->leaves && graph->leaf_slots && graph->output_slots;
+}
+
+static int graph_is_nary(uint8_t op)
+{
+    return op == VALUE_OP_SUM || op == VALUE_OP_DOT || op == VALUE_OP_SOFTMAX ||
+           op == VALUE_OP_SOFTMAX_CE || op == VALUE_OP_FUSED;
+}
+
+/* Leaves get level 0 and every op one more than its deepest parent, so
+   nodes that share a level never depend on each other. */
+static int graph_scan(Graph *graph, GraphBuilder *b, Value **topo)
+{
+    for (uint32_t i = 0; i < graph->node_count; i++)
+    {
+        Value *node = topo[i];
+        ValueOp op = value_get_op(node);
+
+        if (op == VALUE_OP_TENSOR || op == VALUE_OP_CUSTOM)
+        {
+            fprintf(stderr, "[ERROR] graph_capture cannot record op '%s'\n", value_get_op_symbol(node));
+            return 0;
+        }
+
+        b->op[i] = op;
+        b->level[i] = 0;
+        if (op == VALUE_OP_LEAF)
+        {
+            graph->leaf_nodes++;
+            continue;
+        }
+
+        for (size_t j = 0; j < node->prev_count; j++)
+        {
+            size_t parent = 0;
+            node_map_get(&b->index, node->prev[j], &parent);
+            if (b->level[parent] + 1 > b->level[i])
+                b->level[i] = b->level[parent] + 1;
+        }
+
+        if (graph_is_nary(op))
+            graph->arg_total += node->prev_count;
+    }
+    return 1;
+}
+
+static int graph_compare_nodes(const void *pa, const void *pb)
+{
+    const GraphBuilder *b = sort_builder;
+    uint32_t x = *(const uint32_t *)pa, y = *(const uint32_t *)pb;
+
+    if (b->level[x] != b->level[y])
+        return b->level[x] < b->level[y] ? -1 : 1;
+    if (b->op[x] != b->op[y])
+        return b->op[x] < b->op[y] ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+/* Node ids follow (level, opcode, topo position): still a valid
+   topological order, with equal opcodes of one level packed together. */
+static void graph_order(Graph *graph, GraphBuilder *b)
+{
+    for (uint32_t i = 0; i < graph->node_count; i++)
+        b->order[i] = i;
+
+    sort_builder = b;
+    qsort(b->order, graph->node_count, sizeof(uint32_t), graph_compare_nodes);
+    sort_builder = NULL;
+
+    for (uint32_t id = 0; id < graph->node_count; id++)
+        b->ids[b->order[id]] = id;
+}
+
+static void graph_record(Graph *graph, GraphBuilder *b, Value **topo)
+{
+    uint32_t arg = 0;
+
+    for (uint32_t id = 0; id < graph->node_count; id++)
+    {
+        uint32_t src = b->order[id];
+        Value *node = topo[src];
+        uint8_t op = b->op[src];
+
+        graph->data[id] = node->data;
+        graph->ops[id] = op;
+        if (op == VALUE_OP_LEAF)
+            continue;
+
+        if (op == VALUE_OP_POW)
+            graph->params[id] = *(double *)node->backward_ctx;
+        else if (op == VALUE_OP_SOFTMAX || op == VALUE_OP_SOFTMAX_CE)
+        {
+            SoftmaxCtx *ctx = node->backward_ctx;
+            graph->params[id] = ctx->index;
+            graph->aux[id] = ctx->log_sum;
+        }
+        else if (op == VALUE_OP_FUSED)
+            graph->kernels[id] = *(const FusedKernel **)node->backward_ctx;
+        if (op == VALUE_OP_SOFTMAX_CE)
+            graph->label_node = id;
+
+        uint32_t parents[2] = {0, 0};
+        for (size_t j = 0; j < node->prev_count; j++)
+        {
+            size_t slot = 0;
+            node_map_get(&b->index, node->prev[j], &slot);
+            if (graph_is_nary(op))
+                graph->args[arg + j] = b->ids[slot];
+            else if (j < 2)
+                parents[j] = b->ids[slot];
+        }
+
+        if (graph_is_nary(op))
+        {
+            graph->lhs[id] = arg;
+            graph->rhs[id] = node->prev_count;
+            arg += node->prev_count;
+        }
+        else
+        {
+            graph->lhs[id] = parents[0];
+            graph->rhs[id] = parents[1];
+        }
+
+        GraphRun *last = graph->run_count ? &graph->runs[graph->run_count - 1] : NULL;
+        if (last && last->op == op && last->end == id && b->level[b->order[id - 1]] == b->level[src])
+            last->end = id + 1;
+        else
+            graph->runs[graph->run_count++] = (GraphRun){op, id, id + 1};
+    }
+}
+
+static int graph_bind(Graph *graph, GraphBuilder *b, Value **leaves, Value **outputs)
+{
+    for (size_t i = 0; i < graph->leaf_count; i++)
+    {
+        size_t slot;
+        graph->leaves[i] = leaves[i];
+        graph->leaf_slots[i] = GRAPH_NO_SLOT;
+        if (!node_map_get(&b->index, leaves[i], &slot))
+            continue;
+        if (b->op[slot] != VALUE_OP_LEAF)
+        {
+            fprintf(stderr, "[ERROR] graph_capture leaf %zu is not a leaf node\n", i);
+            return 0;
+        }
+        graph->leaf_slots[i] = b->ids[slot];
+    }
+
+    for (size_t i = 0; i < graph->output_count; i++)
+    {
+        size_t slot;
+        if (!node_map_get(&b->index, outputs[i], &slot))
+        {
+            fprintf(stderr, "[ERROR] graph_capture output %zu is not part of the graph\n", i);
+            return 0;
+        }
+        graph->output_slots[i] = b->ids[slot];
+    }
+    return 1;
+}
+
+Graph *graph_capture(Value *root, Value **leaves, size_t leaf_count,
+                     Value **outputs, size_t output_count)
+{
+    size_t count = 0;
+    Value **topo = value_topo(root, &count);
+    if (!topo)
+        return NULL;
+    if (count >= GRAPH_NO_SLOT)
+    {
+        fprintf(stderr, "[ERROR] graph_capture graph is too large\n");
+        return NULL;
+    }
+
+    Graph *graph = calloc(1, sizeof(Graph));
+    if (!graph)
+        return NULL;
+
+    graph->node_count = count;
+    graph->leaf_count = leaf_count;
+    graph->output_count = output_count;
+    graph->label_node = GRAPH_NO_SLOT;
+
+    GraphBuilder b = {0};
+    b.op = malloc(count * sizeof(uint8_t));
+    b.level = malloc(count * sizeof(uint32_t));
+    b.order = malloc(count * sizeof(uint32_t));
+    b.ids = malloc(count * sizeof(uint32_t));
+    int ok = b.op && b.level && b.order && b.ids && node_map_init(&b.index, count);
+
+    for (size_t i = 0; ok && i < count; i++)
+        ok = node_map_insert(&b.index, topo[i], i) >= 0;
+
+    ok = ok && graph_scan(graph, &b, topo) && graph_alloc(graph);
+    if (ok)
+    {
+        graph_order(graph, &b);
+        graph_record(graph, &b, topo);
+        graph->root = b.ids[count - 1];
+        ok = graph_bind(graph, &b, leaves, outputs);
+    }
+
+    graph_builder_free(&b);
+    if (!ok)
+    {
+        graph_free(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+size_t graph_node_count(Graph *graph)
+{
+    return graph ? graph->node_count : 0;
+}
+
+size_t graph_instr_count(Graph *graph)
+{
+    return graph ? graph->node_count - graph->leaf_nodes : 0;
+}
+
+size_t graph_run_count(Graph *graph)
+{
+    return graph ? graph->run_count : 0;
+}
+
+static double graph_log_sum_exp(const double *data, const uint32_t *args, uint32_t n)
+{
+    double max_val = data[args[0]];
+    for (uint32_t j = 1; j < n; j++)
+    {
+        if (data[args[j]] > max_val)
+            max_val = data[args[j]];
+    }
+
+    double sum = 0.0;
+    for (uint32_t j = 0; j < n; j++)
+        sum += exp(data[args[j]] - max_val);
+    return max_val + log(sum);
+}
+
+static void graph_forward_run(Graph *graph, const GraphRun *run)
+{
+    double *data = graph->data;
+    const uint32_t *lhs = graph->lhs, *rhs = graph->rhs;
+    uint32_t begin = run->begin, end = run->end;
+
+    switch (run->op)
+    {
+    case VALUE_OP_ADD:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = data[lhs[j]] + data[rhs[j]];
+        break;
+    case VALUE_OP_SUB:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = data[lhs[j]] - data[rhs[j]];
+        break;
+    case VALUE_OP_MUL:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = data[lhs[j]] * data[rhs[j]];
+        break;
+    case VALUE_OP_DIV:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = data[lhs[j]] / data[rhs[j]];
+        break;
+    case VALUE_OP_POW:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = pow(data[lhs[j]], graph->params[j]);
+        break;
+    case VALUE_OP_RELU:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = data[lhs[j]] > 0 ? data[lhs[j]] : 0;
+        break;
+    case VALUE_OP_TANH:
+        for (uint32_t j = begin; j < end; j++)
+            data[j] = tanh(data[lhs[j]]);
+        break;
+    case VALUE_OP_SUM:
+        for (uint32_t j = begin; j < end; j++)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            double total = 0.0;
+            for (uint32_t k = 0; k < rhs[j]; k++)
+                total += data[a[k]];
+            data[j] = total;
+        }
+        break;
+    case VALUE_OP_DOT:
+        for (uint32_t j = begin; j < end; j++)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            uint32_t half = rhs[j] / 2;
+            double total = 0.0;
+            for (uint32_t k = 0; k < half; k++)
+                total += data[a[k]] * data[a[half + k]];
+            data[j] = total;
+        }
+        break;
+    case VALUE_OP_SOFTMAX:
+        for (uint32_t j = begin; j < end; j++)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            graph->aux[j] = graph_log_sum_exp(data, a, rhs[j]);
+            data[j] = exp(data[a[(uint32_t)graph->params[j]]] - graph->aux[j]);
+        }
+        break;
+    case VALUE_OP_SOFTMAX_CE:
+        for (uint32_t j = begin; j < end; j++)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            graph->aux[j] = graph_log_sum_exp(data, a, rhs[j]);
+            data[j] = graph->aux[j] - data[a[(uint32_t)graph->params[j]]];
+        }
+        break;
+    case VALUE_OP_FUSED:
+        for (uint32_t j = begin; j < end; j++)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            double inputs[FUSE_MAX_INPUTS], regs[FUSE_MAX_CODE];
+            for (uint32_t k = 0; k < rhs[j]; k++)
+                inputs[k] = data[a[k]];
+            data[j] = fused_forward(graph->kernels[j], inputs, regs);
+        }
+        break;
+    }
+}
+
+static void graph_backward_run(Graph *graph, const GraphRun *run)
+{
+    const double *data = graph->data;
+    double *grad = graph->grad;
+    const uint32_t *lhs = graph->lhs, *rhs = graph->rhs;
+    uint32_t begin = run->begin, end = run->end;
+
+    switch (run->op)
+    {
+    case VALUE_OP_ADD:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            grad[lhs[j]] += grad[j];
+            grad[rhs[j]] += grad[j];
+        }
+        break;
+    case VALUE_OP_SUB:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            grad[lhs[j]] += grad[j];
+            grad[rhs[j]] -= grad[j];
+        }
+        break;
+    case VALUE_OP_MUL:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            grad[lhs[j]] += data[rhs[j]] * grad[j];
+            grad[rhs[j]] += data[lhs[j]] * grad[j];
+        }
+        break;
+    case VALUE_OP_DIV:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            double b = data[rhs[j]];
+            if (b == 0)
+            {
+                fprintf(stderr, "[ERROR] Division by zero in graph_backward\n");
+                continue;
+            }
+            grad[lhs[j]] += grad[j] / b;
+            grad[rhs[j]] -= grad[j] * data[lhs[j]] / (b * b);
+        }
+        break;
+    case VALUE_OP_POW:
+        for (uint32_t j = end; j-- > begin;)
+            grad[lhs[j]] += graph->params[j] * pow(data[lhs[j]], graph->params[j] - 1) * grad[j];
+        break;
+    case VALUE_OP_RELU:
+        for (uint32_t j = end; j-- > begin;)
+            grad[lhs[j]] += data[lhs[j]] > 0 ? grad[j] : 0;
+        break;
+    case VALUE_OP_TANH:
+        for (uint32_t j = end; j-- > begin;)
+            grad[lhs[j]] += (1 - data[j] * data[j]) * grad[j];
+        break;
+    case VALUE_OP_SUM:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            for (uint32_t k = 0; k < rhs[j]; k++)
+                grad[a[k]] += grad[j];
+        }
+        break;
+    case VALUE_OP_DOT:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            uint32_t half = rhs[j] / 2;
+            for (uint32_t k = 0; k < half; k++)
+            {
+                grad[a[k]] += data[a[half + k]] * grad[j];
+                grad[a[half + k]] += data[a[k]] * grad[j];
+            }
+        }
+        break;
+    case VALUE_OP_SOFTMAX:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            uint32_t index = (uint32_t)graph->params[j];
+            for (uint32_t k = 0; k < rhs[j]; k++)
+            {
+                double indicator = k == index ? 1.0 : 0.0;
+                double y_k = exp(data[a[k]] - graph->aux[j]);
+                grad[a[k]] += data[j] * (indicator - y_k) * grad[j];
+            }
+        }
+        break;
+    case VALUE_OP_SOFTMAX_CE:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            uint32_t label = (uint32_t)graph->params[j];
+            for (uint32_t k = 0; k < rhs[j]; k++)
+            {
+                double indicator = k == label ? 1.0 : 0.0;
+                grad[a[k]] += (exp(data[a[k]] - graph->aux[j]) - indicator) * grad[j];
+            }
+        }
+        break;
+    case VALUE_OP_FUSED:
+        for (uint32_t j = end; j-- > begin;)
+        {
+            const uint32_t *a = graph->args + lhs[j];
+            double inputs[FUSE_MAX_INPUTS], grads[FUSE_MAX_INPUTS];
+            for (uint32_t k = 0; k < rhs[j]; k++)
+            {
+                inputs[k] = data[a[k]];
+                grads[k] = 0.0;
+            }
+            fused_backward(graph->kernels[j], inputs, data[j], grad[j], grads);
+            for (uint32_t k = 0; k < rhs[j]; k++)
+                grad[a[k]] += grads[k];
+        }
+        break;
+    }
+}
+
+static int graph_is_binary(uint8_t op)
+{
+    return op == VALUE_OP_ADD || op == VALUE_OP_SUB ||
+           op == VALUE_OP_MUL || op == VALUE_OP_DIV;
+}
+
+static uint64_t graph_mix(uint64_t h, uint64_t x)
+{
+    h ^= x + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+static uint64_t graph_bits(double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static uint64_t graph_node_hash(const Graph *graph, uint32_t id)
+{
+    uint8_t op = graph->ops[id];
+    uint64_t h = graph_mix(op, graph_bits(graph->params[id]));
+
+    if (op == VALUE_OP_LEAF)
+        return graph_mix(h, graph_bits(graph->data[id]));
+    if (graph_is_nary(op))
+    {
+        const uint32_t *a = graph->args + graph->lhs[id];
+        h = graph_mix(h, (uintptr_t)graph->kernels[id]);
+        for (uint32_t k = 0; k < graph->rhs[id]; k++)
+            h = graph_mix(h, a[k]);
+        return graph_mix(h, graph->rhs[id]);
+    }
+    return graph_mix(graph_mix(h, graph->lhs[id]), graph->rhs[id]);
+}
+
+static int graph_node_equal(const Graph *graph, uint32_t x, uint32_t y)
+{
+    uint8_t op = graph->ops[x];
+    if (op != graph->ops[y] || graph_bits(graph->params[x]) != graph_bits(graph->params[y]))
+        return 0;
+    if (op == VALUE_OP_LEAF)
+        return graph_bits(graph->data[x]) == graph_bits(graph->data[y]);
+    if (graph->rhs[x] != graph->rhs[y] || graph->kernels[x] != graph->kernels[y])
+        return 0;
+    if (graph_is_nary(op))
+        return memcmp(graph->args + graph->lhs[x], graph->args + graph->lhs[y],
+                      graph->rhs[x] * sizeof(uint32_t)) == 0;
+    return graph->lhs[x] == graph->lhs[y];
+}
+
+/* Returns the first node equal to id, inserting id if there is none. */
+static uint32_t graph_intern(const Graph *graph, uint32_t *table, size_t mask, uint32_t id)
+{
+    size_t slot = graph_node_hash(graph, id) & mask;
+    while (table[slot] != GRAPH_NO_SLOT)
+    {
+        if (graph_node_equal(graph, table[slot], id))
+            return table[slot];
+        slot = (slot + 1) & mask;
+    }
+    table[slot] = id;
+    return id;
+}
+
+static int graph_is_const_value(const Graph *graph, const uint8_t *constant, uint32_t id, double value)
+{
+    return constant[id] && graph->data[id] == value;
+}
+
+/* Rewrites the operands of id through remap and returns whether all of
+   them are constants. Constant zeros are dropped from sums. */
+static int graph_remap_inputs(Graph *graph, const uint32_t *remap, const uint8_t *constant, uint32_t id)
+{
+    uint8_t op = graph->ops[id];
+    int all_const = 1;
+
+    if (graph_is_nary(op))
+    {
+        uint32_t *a = graph->args + graph->lhs[id];
+        uint32_t kept = 0;
+        for (uint32_t k = 0; k < graph->rhs[id]; k++)
+        {
+            uint32_t in = remap[a[k]];
+            all_const &= constant[in];
+            if (op == VALUE_OP_SUM && graph_is_const_value(graph, constant, in, 0.0))
+                continue;
+            a[kept++] = in;
+        }
+        if (op == VALUE_OP_SUM)
+            graph->rhs[id] = kept;
+        return all_const;
+    }
+
+    graph->lhs[id] = remap[graph->lhs[id]];
+    all_const = constant[graph->lhs[id]];
+    if (graph_is_binary(op))
+    {
+        graph->rhs[id] = remap[graph->rhs[id]];
+        all_const &= constant[graph->rhs[id]];
+        if ((op == VALUE_OP_ADD || op == VALUE_OP_MUL) && graph->lhs[id] > graph->rhs[id])
+        {
+            uint32_t t = graph->lhs[id];
+            graph->lhs[id] = graph->rhs[id];
+            graph->rhs[id] = t;
+        }
+    }
+    return all_const;
+}
+
+/* x + 0, x - 0, x * 1, x / 1, x ^ 1 and single-term sums. */
+static uint32_t graph_identity(const Graph *graph, const uint8_t *constant, uint32_t id)
+{
+    uint32_t l = graph->lhs[id], r = graph->rhs[id];
+
+    switch (graph->ops[id])
+    {
+    case VALUE_OP_ADD:
+        if (graph_is_const_value(graph, constant, l, 0.0))
+            return r;
+        return graph_is_const_value(graph, constant, r, 0.0) ? l : GRAPH_NO_SLOT;
+    case VALUE_OP_MUL:
+        if (graph_is_const_value(graph, constant, l, 1.0))
+            return r;
+        return graph_is_const_value(graph, constant, r, 1.0) ? l : GRAPH_NO_SLOT;
+    case VALUE_OP_SUB:
+        return graph_is_const_value(graph, constant, r, 0.0) ? l : GRAPH_NO_SLOT;
+    case VALUE_OP_DIV:
+        return graph_is_const_value(graph, constant, r, 1.0) ? l : GRAPH_NO_SLOT;
+    case VALUE_OP_POW:
+        return graph->params[id] == 1.0 ? l : GRAPH_NO_SLOT;
+    case VALUE_OP_SUM:
+        return graph->rhs[id] == 1 ? graph->args[l] : GRAPH_NO_SLOT;
+    default:
+        return GRAPH_NO_SLOT;
+    }
+}
+
+/* Renumbers the live nodes the way graph_capture does and rebuilds the
+   arrays and runs at the new size. */
+static int graph_compact(Graph *graph, const uint32_t *remap, const uint8_t *live)
+{
+    Graph next = *graph;
+    GraphBuilder b = {0};
+    uint32_t n = graph->node_count, m = 0;
+
+    b.op = graph->ops;
+    b.level = malloc(n * sizeof(uint32_t));
+    b.order = malloc(n * sizeof(uint32_t));
+    b.ids = malloc(n * sizeof(uint32_t));
+    int ok = b.level && b.order && b.ids;
+
+    next.leaf_nodes = 0;
+    next.arg_total = 0;
+    next.run_count = 0;
+    for (uint32_t id = 0; ok && id < n; id++)
+    {
+        if (!live[id])
+            continue;
+        uint8_t op = graph->ops[id];
+        b.order[m++] = id;
+        b.level[id] = 0;
+        if (op == VALUE_OP_LEAF)
+        {
+            next.leaf_nodes++;
+            continue;
+        }
+
+        uint32_t count = graph_is_nary(op) ? graph->rhs[id] : graph_is_binary(op) ? 2 : 1;
+        const uint32_t *in = graph_is_nary(op) ? graph->args + graph->lhs[id] : graph->lhs + id;
+        for (uint32_t k = 0; k < count; k++)
+        {
+            uint32_t parent = k == 1 && !graph_is_nary(op) ? graph->rhs[id] : in[k];
+            if (b.level[parent] + 1 > b.level[id])
+                b.level[id] = b.level[parent] + 1;
+        }
+        if (graph_is_nary(op))
+            next.arg_total += graph->rhs[id];
+    }
+
+    next.node_count = m;
+    int allocated = ok;
+    ok = ok && graph_alloc(&next);
+    if (ok)
+    {
+        sort_builder = &b;
+        qsort(b.order, m, sizeof(uint32_t), graph_compare_nodes);
+        sort_builder = NULL;
+        for (uint32_t k = 0; k < m; k++)
+            b.ids[b.order[k]] = k;
+
+        uint32_t arg = 0;
+        for (uint32_t k = 0; k < m; k++)
+        {
+            uint32_t src = b.order[k];
+            uint8_t op = graph->ops[src];
+
+            next.data[k] = graph->data[src];
+            next.ops[k] = op;
+            next.params[k] = graph->params[src];
+            next.aux[k] = graph->aux[src];
+            next.kernels[k] = graph->kernels[src];
+            if (op == VALUE_OP_LEAF)
+                continue;
+
+            if (graph_is_nary(op))
+            {
+                const uint32_t *a = graph->args + graph->lhs[src];
+                for (uint32_t j = 0; j < graph->rhs[src]; j++)
+                    next.args[arg + j] = b.ids[a[j]];
+                next.lhs[k] = arg;
+                next.rhs[k] = graph->rhs[src];
+                arg += graph->rhs[src];
+            }
+            else
+            {
+                next.lhs[k] = b.ids[graph->lhs[src]];
+                next.rhs[k] = graph_is_binary(op) ? b.ids[graph->rhs[src]] : 0;
+            }
+
+            GraphRun *last = next.run_count ? &next.runs[next.run_count - 1] : NULL;
+            if (last && last->op == op && last->end == k && b.level[b.order[k - 1]] == b.level[src])
+                last->end = k + 1;
+            else
+                next.runs[next.run_count++] = (GraphRun){op, k, k + 1};
+        }
+
+        for (size_t i = 0; i < graph->leaf_count; i++)
+        {
+            uint32_t slot = graph->leaf_slots[i];
+            next.leaves[i] = graph->leaves[i];
+            next.leaf_slots[i] = slot != GRAPH_NO_SLOT && live[slot] ? b.ids[slot] : GRAPH_NO_SLOT;
+        }
+        for (size_t i = 0; i < graph->output_count; i++)
+            next.output_slots[i] = b.ids[remap[graph->output_slots[i]]];
+        next.root = b.ids[remap[graph->root]];
+        next.label_node = graph->label_node != GRAPH_NO_SLOT && live[graph->label_node]
+                              ? b.ids[graph->label_node]
+                              : GRAPH_NO_SLOT;
+
+        graph_release(graph);
+        *graph = next;
+    }
+    else if (allocated)
+        graph_release(&next);
+
+    free(b.level);
+    free(b.order);
+    free(b.ids);
+    return ok;
+}
+
+/* Folds operations on constants, drops identity operations and merges
+   nodes with the same op and operands, then rebuilds the graph without
+   the dead nodes. Leaves not bound in graph_capture count as constants. */
+int graph_optimize(Graph *graph, GraphOptStats *stats)
+{
+    if (!graph)
+        return 0;
+
+    uint32_t n = graph->node_count;
+    size_t capacity = 2;
+    while (capacity < 2 * (size_t)n)
+        capacity <<= 1;
+
+    uint32_t *remap = malloc(n * sizeof(uint32_t));
+    uint32_t *table = malloc(capacity * sizeof(uint32_t));
+    uint8_t *constant = malloc(n);
+    uint8_t *live = calloc(n, 1);
+    if (!remap || !table || !constant || !live)
+    {
+        fprintf(stderr, "[ERROR] Memory allocation failed in graph_optimize\n");
+        free(remap);
+        free(table);
+        free(constant);
+        free(live);
+        return 0;
+    }
+
+    GraphOptStats s = {n, n, 0, 0, 0};
+    memset(table, 0xff, capacity * sizeof(uint32_t));
+    memset(constant, 1, n);
+    for (size_t i = 0; i < graph->leaf_count; i++)
+    {
+        if (graph->leaf_slots[i] != GRAPH_NO_SLOT)
+            constant[graph->leaf_slots[i]] = 0;
+    }
+
+    for (uint32_t id = 0; id < n; id++)
+    {
+        remap[id] = id;
+        if (graph->ops[id] == VALUE_OP_LEAF)
+        {
+            if (constant[id])
+                s.merged += (remap[id] = graph_intern(graph, table, capacity - 1, id)) != id;
+            continue;
+        }
+
+        int all_const = graph_remap_inputs(graph, remap, constant, id);
+        if (id == graph->label_node)
+        {
+            constant[id] = 0;
+            continue;
+        }
+
+        if (all_const)
+        {
+            graph_forward_run(graph, &(GraphRun){graph->ops[id], id, id + 1});
+            graph->ops[id] = VALUE_OP_LEAF;
+            graph->params[id] = 0.0;
+            graph->kernels[id] = NULL;
+            s.folded++;
+            s.merged += (remap[id] = graph_intern(graph, table, capacity - 1, id)) != id;
+            continue;
+        }
+
+        constant[id] = 0;
+        uint32_t same = graph_identity(graph, constant, id);
+        if (same != GRAPH_NO_SLOT)
+        {
+            remap[id] = same;
+            s.identities++;
+            continue;
+        }
+        s.merged += (remap[id] = graph_intern(graph, table, capacity - 1, id)) != id;
+    }
+
+    live[remap[graph->root]] = 1;
+    for (size_t i = 0; i < graph->output_count; i++)
+        live[remap[graph->output_slots[i]]] = 1;
+    for (uint32_t id = n; id-- > 0;)
+    {
+        uint8_t op = graph->ops[id];
+        if (!live[id] || op == VALUE_OP_LEAF)
+            continue;
+        if (graph_is_nary(op))
+        {
+            for (uint32_t k = 0; k < graph->rhs[id]; k++)
+                live[graph->args[graph->lhs[id] + k]] = 1;
+        }
+        else
+        {
+            live[graph->lhs[id]] = 1;
+            if (graph_is_binary(op))
+                live[graph->rhs[id]] = 1;
+        }
+    }
+
+    int ok = graph_compact(graph, remap, live);
+    s.nodes_after = graph->node_count;
+    if (stats)
+        *stats = s;
+
+    free(remap);
+    free(table);
+    free(constant);
+    free(live);
+    return ok;
+}
+
+double graph_forward(Graph *graph)
+{
+    for (size_t i = 0; i < graph->leaf_count; i++)
+    {
+        if (graph->leaf_slots[i] != GRAPH_NO_SLOT)
+            graph->data[graph->leaf_slots[i]] = graph->leaves[i]->data;
+    }
+
+    for (size_t r = 0; r < graph->run_count; r++)
+        graph_forward_run(graph, &graph->runs[r]);
+
+    return graph->data[graph->root];
+}
+
+void graph_backward(Graph *graph)
+{
+    memset(graph->grad, 0, graph->node_count * sizeof(double));
+    graph->grad[graph->root] = 1.0;
+
+    for (size_t r = graph->run_count; r-- > 0;)
+        graph_backward_run(graph, &graph->runs[r]);
+
+    for (size_t i = 0; i < graph->leaf_count; i++)
+    {
+        uint32_t slot = graph->leaf_slots[i];
+        graph->leaves[i]->grad = slot != GRAPH_NO_SLOT ? graph->grad[slot] : 0.0;
+    }
+}
+
+int graph_set_label(Graph *graph, int label)
+{
+    if (!graph || graph->label_node == GRAPH_NO_SLOT)
+        return 0;
+    if (label < 0 || (uint32_t)label >= graph->rhs[graph->label_node])
+    {
+        fprintf(stderr, "[ERROR] Label %d out of range in graph_set_label\n", label);
+        return 0;
+    }
+    graph->params[graph->label_node] = label;
+    return 1;
+}
+
+double graph_output(Graph *graph, size_t index)
+{
+    if (!graph || index >= graph->output_count)
+        return 0.0;
+    return graph->data[graph->output_slots[index]];
+}
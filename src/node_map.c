@@ -0,0 +1,111 @@
+#include "../include/node_map.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static size_t node_map_slot(Value *key, size_t capacity)
+{
+    uint64_t h = (uint64_t)(uintptr_t)key >> 4;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (capacity - 1);
+}
+
+static int node_map_alloc(NodeMap *map, size_t capacity)
+{
+    map->keys = malloc(capacity * sizeof(Value *));
+    map->vals = malloc(capacity * sizeof(size_t));
+    map->stamps = calloc(capacity, sizeof(unsigned int));
+    if (!map->keys || !map->vals || !map->stamps)
+    {
+        free(map->keys);
+        free(map->vals);
+        free(map->stamps);
+        memset(map, 0, sizeof(NodeMap));
+        return 0;
+    }
+    map->epoch = 1;
+    map->capacity = capacity;
+    map->count = 0;
+    return 1;
+}
+
+int node_map_init(NodeMap *map, size_t expected)
+{
+    size_t capacity = 64;
+    while (capacity < expected * 2)
+        capacity *= 2;
+    return node_map_alloc(map, capacity);
+}
+
+void node_map_free(NodeMap *map)
+{
+    if (!map)
+        return;
+    free(map->keys);
+    free(map->vals);
+    free(map->stamps);
+    memset(map, 0, sizeof(NodeMap));
+}
+
+void node_map_clear(NodeMap *map)
+{
+    map->count = 0;
+    if (++map->epoch == 0)
+    {
+        memset(map->stamps, 0, map->capacity * sizeof(unsigned int));
+        map->epoch = 1;
+    }
+}
+
+static int node_map_grow(NodeMap *map)
+{
+    NodeMap grown;
+    if (!node_map_alloc(&grown, map->capacity * 2))
+        return 0;
+
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->stamps[i] == map->epoch)
+            node_map_insert(&grown, map->keys[i], map->vals[i]);
+    }
+
+    node_map_free(map);
+    *map = grown;
+    return 1;
+}
+
+int node_map_insert(NodeMap *map, Value *key, size_t val)
+{
+    if ((map->count + 1) * 2 > map->capacity && !node_map_grow(map))
+        return -1;
+
+    size_t mask = map->capacity - 1;
+    for (size_t i = node_map_slot(key, map->capacity);; i = (i + 1) & mask)
+    {
+        if (map->stamps[i] != map->epoch)
+        {
+            map->stamps[i] = map->epoch;
+            map->keys[i] = key;
+            map->vals[i] = val;
+            map->count++;
+            return 1;
+        }
+        if (map->keys[i] == key)
+            return 0;
+    }
+}
+
+int node_map_get(const NodeMap *map, Value *key, size_t *val)
+{
+    size_t mask = map->capacity - 1;
+    for (size_t i = node_map_slot(key, map->capacity); map->stamps[i] == map->epoch; i = (i + 1) & mask)
+    {
+        if (map->keys[i] == key)
+        {
+            if (val)
+                *val = map->vals[i];
+            return 1;
+        }
+    }
+    return 0;
+}
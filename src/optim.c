@@ -0,0 +1,478 @@
+#include "../include/optim.h"
+#include "../include/thread_pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OPTIM_X86 1
+#endif
+
+#define OPTIM_PARALLEL_MIN 65536
+#define OPTIM_SHARD_ALIGN 8
+#define OPTIM_BLOCK 256
+
+typedef struct
+{
+    double lr;
+    double clip;
+    double l2;
+    double keep;
+    double momentum;
+    double beta1;
+    double beta2;
+    double step_size;
+    double inv_bias2;
+    double eps;
+} OptimStep;
+
+typedef void (*OptimKernel)(const OptimStep *s, double *p, const double *g,
+                            double *m, double *v, size_t n);
+
+typedef struct
+{
+    OptimConfig config;
+    OptimStep step;
+    size_t offset;
+    size_t count;
+
+    Value **values;
+    Tensor *tensor;
+    double *master;
+    double *m;
+    double *v;
+    double *buffer;
+} OptimGroup;
+
+struct Optimizer
+{
+    OptimGroup *groups;
+    size_t group_count;
+    size_t group_capacity;
+    size_t total;
+    long steps;
+
+    ThreadPool *pool;
+    int num_workers;
+    OptimKernel sgd_kernel;
+    OptimKernel adam_kernel;
+};
+
+OptimConfig optim_sgd(double lr, double momentum)
+{
+    return (OptimConfig){OPTIM_SGD, lr, momentum, 0.9, 0.999, 1e-8, 0.0, 0.0};
+}
+
+OptimConfig optim_adam(double lr)
+{
+    return (OptimConfig){OPTIM_ADAM, lr, 0.0, 0.9, 0.999, 1e-8, 0.0, 0.0};
+}
+
+OptimConfig optim_adamw(double lr, double weight_decay)
+{
+    return (OptimConfig){OPTIM_ADAMW, lr, 0.0, 0.9, 0.999, 1e-8, weight_decay, 0.0};
+}
+
+/* Both kernels fold clipping, weight decay and the moment updates into a
+   single pass: p = p * keep - lr * update(clip(g) + l2 * p). */
+static inline double optim_clip(double g, double clip)
+{
+    return g < -clip ? -clip : (g > clip ? clip : g);
+}
+
+static void optim_sgd_scalar(const OptimStep *s, double *p, const double *g,
+                             double *m, double *v, size_t n)
+{
+    (void)v;
+    for (size_t i = 0; i < n; i++)
+    {
+        double grad = optim_clip(g[i], s->clip) + s->l2 * p[i];
+        m[i] = s->momentum * m[i] + grad;
+        p[i] = p[i] * s->keep - s->lr * m[i];
+    }
+}
+
+static void optim_adam_scalar(const OptimStep *s, double *p, const double *g,
+                              double *m, double *v, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        double grad = optim_clip(g[i], s->clip) + s->l2 * p[i];
+        m[i] = s->beta1 * m[i] + (1.0 - s->beta1) * grad;
+        v[i] = s->beta2 * v[i] + (1.0 - s->beta2) * grad * grad;
+        p[i] = p[i] * s->keep - s->step_size * m[i] / (sqrt(v[i] * s->inv_bias2) + s->eps);
+    }
+}
+
+#ifdef OPTIM_X86
+__attribute__((target("avx2,fma"))) static void optim_sgd_avx2(const OptimStep *s, double *p, const double *g,
+                                                                double *m, double *v, size_t n)
+{
+    __m256d hi = _mm256_set1_pd(s->clip);
+    __m256d lo = _mm256_set1_pd(-s->clip);
+    __m256d l2 = _mm256_set1_pd(s->l2);
+    __m256d keep = _mm256_set1_pd(s->keep);
+    __m256d lr = _mm256_set1_pd(s->lr);
+    __m256d mu = _mm256_set1_pd(s->momentum);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d pi = _mm256_loadu_pd(p + i);
+        __m256d gi = _mm256_min_pd(hi, _mm256_max_pd(lo, _mm256_loadu_pd(g + i)));
+        gi = _mm256_fmadd_pd(l2, pi, gi);
+        __m256d mi = _mm256_fmadd_pd(mu, _mm256_loadu_pd(m + i), gi);
+        _mm256_storeu_pd(m + i, mi);
+        _mm256_storeu_pd(p + i, _mm256_fnmadd_pd(lr, mi, _mm256_mul_pd(pi, keep)));
+    }
+    optim_sgd_scalar(s, p + i, g + i, m + i, v, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static void optim_adam_avx2(const OptimStep *s, double *p, const double *g,
+                                                                 double *m, double *v, size_t n)
+{
+    __m256d hi = _mm256_set1_pd(s->clip);
+    __m256d lo = _mm256_set1_pd(-s->clip);
+    __m256d l2 = _mm256_set1_pd(s->l2);
+    __m256d keep = _mm256_set1_pd(s->keep);
+    __m256d b1 = _mm256_set1_pd(s->beta1);
+    __m256d b2 = _mm256_set1_pd(s->beta2);
+    __m256d c1 = _mm256_set1_pd(1.0 - s->beta1);
+    __m256d c2 = _mm256_set1_pd(1.0 - s->beta2);
+    __m256d step = _mm256_set1_pd(s->step_size);
+    __m256d inv_bias2 = _mm256_set1_pd(s->inv_bias2);
+    __m256d eps = _mm256_set1_pd(s->eps);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d pi = _mm256_loadu_pd(p + i);
+        __m256d gi = _mm256_min_pd(hi, _mm256_max_pd(lo, _mm256_loadu_pd(g + i)));
+        gi = _mm256_fmadd_pd(l2, pi, gi);
+        __m256d mi = _mm256_fmadd_pd(b1, _mm256_loadu_pd(m + i), _mm256_mul_pd(c1, gi));
+        __m256d vi = _mm256_fmadd_pd(b2, _mm256_loadu_pd(v + i), _mm256_mul_pd(c2, _mm256_mul_pd(gi, gi)));
+        _mm256_storeu_pd(m + i, mi);
+        _mm256_storeu_pd(v + i, vi);
+
+        __m256d denom = _mm256_add_pd(_mm256_sqrt_pd(_mm256_mul_pd(vi, inv_bias2)), eps);
+        __m256d update = _mm256_div_pd(_mm256_mul_pd(step, mi), denom);
+        _mm256_storeu_pd(p + i, _mm256_sub_pd(_mm256_mul_pd(pi, keep), update));
+    }
+    optim_adam_scalar(s, p + i, g + i, m + i, v + i, n - i);
+}
+#endif
+
+Optimizer *optim_create(int num_threads)
+{
+    Optimizer *opt = calloc(1, sizeof(Optimizer));
+    if (!opt)
+        return NULL;
+
+    opt->sgd_kernel = optim_sgd_scalar;
+    opt->adam_kernel = optim_adam_scalar;
+#ifdef OPTIM_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        opt->sgd_kernel = optim_sgd_avx2;
+        opt->adam_kernel = optim_adam_avx2;
+    }
+#endif
+
+    opt->num_workers = 1;
+    if (num_threads != 1)
+    {
+        opt->pool = thread_pool_create(num_threads);
+        if (!opt->pool)
+        {
+            free(opt);
+            return NULL;
+        }
+        opt->num_workers = thread_pool_size(opt->pool);
+    }
+    return opt;
+}
+
+void optim_free(Optimizer *opt)
+{
+    if (!opt)
+        return;
+
+    for (size_t i = 0; i < opt->group_count; i++)
+    {
+        free(opt->groups[i].buffer);
+        free(opt->groups[i].values);
+    }
+    free(opt->groups);
+    thread_pool_free(opt->pool);
+    free(opt);
+}
+
+static OptimGroup *optim_new_group(Optimizer *opt, size_t count, OptimConfig config)
+{
+    if (config.kind != OPTIM_SGD && config.kind != OPTIM_ADAM && config.kind != OPTIM_ADAMW)
+    {
+        fprintf(stderr, "[ERROR] Unknown optimizer kind %d\n", config.kind);
+        return NULL;
+    }
+
+    if (opt->group_count == opt->group_capacity)
+    {
+        size_t capacity = opt->group_capacity ? opt->group_capacity * 2 : 4;
+        OptimGroup *groups = realloc(opt->groups, capacity * sizeof(OptimGroup));
+        if (!groups)
+            return NULL;
+        opt->groups = groups;
+        opt->group_capacity = capacity;
+    }
+
+    OptimGroup *group = &opt->groups[opt->group_count];
+    memset(group, 0, sizeof(OptimGroup));
+    group->config = config;
+    group->offset = opt->total;
+    group->count = count;
+    return group;
+}
+
+static void optim_commit_group(Optimizer *opt, OptimGroup *group)
+{
+    opt->group_count++;
+    opt->total += group->count;
+}
+
+int optim_add_values(Optimizer *opt, Value **params, size_t count, OptimConfig config)
+{
+    if (!opt || !params || count == 0)
+        return -1;
+
+    OptimGroup *group = optim_new_group(opt, count, config);
+    if (!group)
+        return -1;
+
+    group->buffer = calloc(2 * count, sizeof(double));
+    group->values = malloc(count * sizeof(Value *));
+    if (!group->buffer || !group->values)
+    {
+        fprintf(stderr, "[ERROR] Memory allocation failed for optimizer state\n");
+        free(group->buffer);
+        free(group->values);
+        return -1;
+    }
+    memcpy(group->values, params, count * sizeof(Value *));
+    group->m = group->buffer;
+    group->v = group->buffer + count;
+
+    optim_commit_group(opt, group);
+    return (int)(opt->group_count - 1);
+}
+
+int optim_add_tensor(Optimizer *opt, Tensor *t, OptimConfig config)
+{
+    if (!opt || !t)
+        return -1;
+    if (!t->grad || !tensor_is_contiguous(t))
+    {
+        fprintf(stderr, "[ERROR] optim_add_tensor requires a contiguous tensor with gradients\n");
+        return -1;
+    }
+
+    OptimGroup *group = optim_new_group(opt, t->size, config);
+    if (!group)
+        return -1;
+
+#ifdef GIGAGRAD_FLOAT32
+    /* float32 tensors are stepped against a float64 master copy so small
+       updates are not lost to rounding. */
+    group->buffer = calloc(3 * t->size, sizeof(double));
+#else
+    group->buffer = calloc(2 * t->size, sizeof(double));
+#endif
+    if (!group->buffer)
+    {
+        fprintf(stderr, "[ERROR] Memory allocation failed for optimizer state\n");
+        return -1;
+    }
+    group->tensor = t;
+    group->m = group->buffer;
+    group->v = group->buffer + t->size;
+#ifdef GIGAGRAD_FLOAT32
+    group->master = group->buffer + 2 * t->size;
+    for (size_t i = 0; i < t->size; i++)
+        group->master[i] = t->data[i];
+#endif
+
+    optim_commit_group(opt, group);
+    return (int)(opt->group_count - 1);
+}
+
+size_t optim_param_count(Optimizer *opt)
+{
+    return opt ? opt->total : 0;
+}
+
+void optim_set_lr(Optimizer *opt, double lr)
+{
+    if (!opt)
+        return;
+    for (size_t i = 0; i < opt->group_count; i++)
+        opt->groups[i].config.lr = lr;
+}
+
+/* State layout: the step counter, then m and v for every group in the
+   order the groups were added. Parameters themselves are not included. */
+size_t optim_state_size(Optimizer *opt)
+{
+    return opt ? 1 + 2 * opt->total : 0;
+}
+
+int optim_get_state(Optimizer *opt, double *state, size_t count)
+{
+    if (!opt || !state || count != optim_state_size(opt))
+    {
+        fprintf(stderr, "[ERROR] Optimizer state size mismatch\n");
+        return 0;
+    }
+
+    state[0] = (double)opt->steps;
+    for (size_t i = 0; i < opt->group_count; i++)
+    {
+        OptimGroup *group = &opt->groups[i];
+        memcpy(state + 1 + 2 * group->offset, group->buffer, 2 * group->count * sizeof(double));
+    }
+    return 1;
+}
+
+int optim_set_state(Optimizer *opt, const double *state, size_t count)
+{
+    if (!opt || !state || count != optim_state_size(opt))
+    {
+        fprintf(stderr, "[ERROR] Optimizer state size mismatch\n");
+        return 0;
+    }
+
+    opt->steps = (long)state[0];
+    for (size_t i = 0; i < opt->group_count; i++)
+    {
+        OptimGroup *group = &opt->groups[i];
+        memcpy(group->buffer, state + 1 + 2 * group->offset, 2 * group->count * sizeof(double));
+    }
+    return 1;
+}
+
+static void optim_prepare(OptimGroup *group, long t)
+{
+    const OptimConfig *c = &group->config;
+    OptimStep *s = &group->step;
+
+    s->lr = c->lr;
+    s->clip = c->clip > 0.0 ? c->clip : INFINITY;
+    s->momentum = c->momentum;
+    s->beta1 = c->beta1;
+    s->beta2 = c->beta2;
+    s->eps = c->eps;
+
+    /* AdamW decays the weights directly; SGD and Adam fold the decay into
+       the gradient as an L2 term. */
+    s->l2 = c->kind == OPTIM_ADAMW ? 0.0 : c->weight_decay;
+    s->keep = c->kind == OPTIM_ADAMW ? 1.0 - c->lr * c->weight_decay : 1.0;
+
+    s->step_size = c->lr / (1.0 - pow(c->beta1, t));
+    s->inv_bias2 = 1.0 / (1.0 - pow(c->beta2, t));
+}
+
+/* In float32 builds the tensor may have been written since the last step
+   (a model load, a manual init), so any weight that no longer matches its
+   rounded master value is taken from the tensor before stepping. */
+static void optim_run_tensor(OptimGroup *group, OptimKernel kernel, size_t lo, size_t hi)
+{
+    Tensor *t = group->tensor;
+#ifdef GIGAGRAD_FLOAT32
+    double grad[OPTIM_BLOCK];
+    for (size_t j = lo; j < hi; j += OPTIM_BLOCK)
+    {
+        size_t n = hi - j < OPTIM_BLOCK ? hi - j : OPTIM_BLOCK;
+        for (size_t k = 0; k < n; k++)
+        {
+            grad[k] = t->grad[j + k];
+            if ((real_t)group->master[j + k] != t->data[j + k])
+                group->master[j + k] = t->data[j + k];
+        }
+
+        kernel(&group->step, group->master + j, grad, group->m + j, group->v + j, n);
+
+        for (size_t k = 0; k < n; k++)
+            t->data[j + k] = (real_t)group->master[j + k];
+    }
+#else
+    kernel(&group->step, t->data + lo, t->grad + lo, group->m + lo, group->v + lo, hi - lo);
+#endif
+}
+
+/* Scalar params are staged through an L1-sized block so the kernel still
+   sees contiguous data and grads. */
+static void optim_run_values(OptimGroup *group, OptimKernel kernel, size_t lo, size_t hi)
+{
+    double data[OPTIM_BLOCK], grad[OPTIM_BLOCK];
+    for (size_t j = lo; j < hi; j += OPTIM_BLOCK)
+    {
+        size_t n = hi - j < OPTIM_BLOCK ? hi - j : OPTIM_BLOCK;
+        Value **values = group->values + j;
+        for (size_t k = 0; k < n; k++)
+        {
+            data[k] = values[k]->data;
+            grad[k] = values[k]->grad;
+        }
+
+        kernel(&group->step, data, grad, group->m + j, group->v + j, n);
+
+        for (size_t k = 0; k < n; k++)
+            values[k]->data = data[k];
+    }
+}
+
+static void optim_run_range(Optimizer *opt, size_t begin, size_t end)
+{
+    for (size_t i = 0; i < opt->group_count; i++)
+    {
+        OptimGroup *group = &opt->groups[i];
+        if (end <= group->offset || begin >= group->offset + group->count)
+            continue;
+
+        size_t lo = begin > group->offset ? begin - group->offset : 0;
+        size_t hi = end - group->offset < group->count ? end - group->offset : group->count;
+
+        OptimKernel kernel = group->config.kind == OPTIM_SGD ? opt->sgd_kernel : opt->adam_kernel;
+        if (group->tensor)
+            optim_run_tensor(group, kernel, lo, hi);
+        else
+            optim_run_values(group, kernel, lo, hi);
+    }
+}
+
+static void optim_shard_run(void *ctx, int w)
+{
+    Optimizer *opt = ctx;
+    size_t shard = (opt->total + opt->num_workers - 1) / opt->num_workers;
+    shard = (shard + OPTIM_SHARD_ALIGN - 1) / OPTIM_SHARD_ALIGN * OPTIM_SHARD_ALIGN;
+
+    size_t begin = w * shard;
+    size_t end = begin + shard < opt->total ? begin + shard : opt->total;
+    if (begin < end)
+        optim_run_range(opt, begin, end);
+}
+
+void optim_step(Optimizer *opt)
+{
+    if (!opt || opt->total == 0)
+        return;
+
+    opt->steps++;
+    for (size_t i = 0; i < opt->group_count; i++)
+        optim_prepare(&opt->groups[i], opt->steps);
+
+    if (opt->pool && opt->num_workers > 1 && opt->total >= OPTIM_PARALLEL_MIN)
+        thread_pool_run(opt->pool, optim_shard_run, opt);
+    else
+        optim_run_range(opt, 0, opt->total);
+}
@@ -0,0 +1,207 @@
+#include "../include/parallel_backward.h"
+#include "../include/engine.h"
+#include "../include/tensor.h"
+#include "../include/node_map.h"
+#include "../include/profile.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+typedef struct
+{
+    Value **items;
+    size_t top;
+    size_t bottom;
+    atomic_flag lock;
+} ReadyDeque;
+
+typedef struct
+{
+    Value **topo;
+    size_t topo_count;
+    NodeMap index;
+    atomic_int *pending;
+    atomic_size_t remaining;
+
+    ReadyDeque *deques;
+    int num_workers;
+} BackwardJob;
+
+static void deque_lock(ReadyDeque *d)
+{
+    while (atomic_flag_test_and_set_explicit(&d->lock, memory_order_acquire))
+        sched_yield();
+}
+
+static void deque_unlock(ReadyDeque *d)
+{
+    atomic_flag_clear_explicit(&d->lock, memory_order_release);
+}
+
+static void deque_push(ReadyDeque *d, Value *v)
+{
+    deque_lock(d);
+    d->items[d->bottom++] = v;
+    deque_unlock(d);
+}
+
+static Value *deque_pop(ReadyDeque *d)
+{
+    Value *v = NULL;
+    deque_lock(d);
+    if (d->bottom > d->top)
+        v = d->items[--d->bottom];
+    deque_unlock(d);
+    return v;
+}
+
+static Value *deque_steal(ReadyDeque *d)
+{
+    Value *v = NULL;
+    deque_lock(d);
+    if (d->bottom > d->top)
+        v = d->items[d->top++];
+    deque_unlock(d);
+    return v;
+}
+
+static Value *backward_next(BackwardJob *job, int w)
+{
+    Value *v = deque_pop(&job->deques[w]);
+    for (int k = 1; !v && k < job->num_workers; k++)
+        v = deque_steal(&job->deques[(w + k) % job->num_workers]);
+    return v;
+}
+
+static void backward_worker(void *ctx, int w)
+{
+    BackwardJob *job = ctx;
+    value_set_atomic_grads(1);
+
+    Value *node = NULL;
+    while (node || atomic_load_explicit(&job->remaining, memory_order_acquire) > 0)
+    {
+        if (!node)
+            node = backward_next(job, w);
+        if (!node)
+        {
+            sched_yield();
+            continue;
+        }
+
+        if (node->backward)
+            PROFILE_BACKWARD(node);
+
+        /* The first parent that becomes ready runs next on this worker
+           without touching the deque, so straight chains stay local. */
+        Value *next = NULL;
+        for (size_t i = 0; i < node->prev_count; i++)
+        {
+            size_t idx;
+            if (!node->prev[i] || !node_map_get(&job->index, node->prev[i], &idx))
+                continue;
+            if (atomic_fetch_sub_explicit(&job->pending[idx], 1, memory_order_acq_rel) != 1)
+                continue;
+            if (!next)
+                next = node->prev[i];
+            else
+                deque_push(&job->deques[w], node->prev[i]);
+        }
+
+        atomic_fetch_sub_explicit(&job->remaining, 1, memory_order_release);
+        node = next;
+    }
+
+    value_set_atomic_grads(0);
+}
+
+static void backward_job_free(BackwardJob *job)
+{
+    if (job->deques)
+    {
+        for (int w = 0; w < job->num_workers; w++)
+            free(job->deques[w].items);
+        free(job->deques);
+    }
+    free(job->pending);
+    node_map_free(&job->index);
+}
+
+static int backward_job_init(BackwardJob *job, Value *root, int num_workers)
+{
+    job->topo = value_topo(root, &job->topo_count);
+    if (!job->topo)
+        return 0;
+    if (root->flags & VALUE_FLAG_LAZY)
+        value_realize_topo(job->topo, job->topo_count);
+
+    size_t n = job->topo_count;
+    job->num_workers = num_workers;
+    job->pending = calloc(n, sizeof(atomic_int));
+    job->deques = calloc(num_workers, sizeof(ReadyDeque));
+    if (!job->pending || !job->deques || !node_map_init(&job->index, n))
+        return 0;
+
+    for (int w = 0; w < num_workers; w++)
+    {
+        job->deques[w].items = malloc(n * sizeof(Value *));
+        if (!job->deques[w].items)
+            return 0;
+        atomic_flag_clear(&job->deques[w].lock);
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (node_map_insert(&job->index, job->topo[i], i) < 0)
+            return 0;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        Value *node = job->topo[i];
+        for (size_t j = 0; j < node->prev_count; j++)
+        {
+            size_t idx;
+            if (node->prev[j] && node_map_get(&job->index, node->prev[j], &idx))
+                atomic_fetch_add_explicit(&job->pending[idx], 1, memory_order_relaxed);
+        }
+    }
+
+    atomic_store(&job->remaining, n);
+    return 1;
+}
+
+void value_backward_parallel(Value *v, ThreadPool *pool)
+{
+    if (!v)
+        return;
+
+    int num_workers = thread_pool_size(pool);
+    if (num_workers <= 1)
+    {
+        value_backward(v);
+        return;
+    }
+
+    BackwardJob job = {0};
+    if (!backward_job_init(&job, v, num_workers))
+    {
+        fprintf(stderr, "[ERROR] Memory allocation failed in value_backward_parallel\n");
+        backward_job_free(&job);
+        return;
+    }
+
+    for (size_t i = 0; i < job.topo_count; i++)
+    {
+        job.topo[i]->grad = 0.0;
+        if (job.topo[i]->flags & VALUE_FLAG_TENSOR)
+            tensor_zero_grad(job.topo[i]->backward_ctx);
+    }
+
+    v->grad = 1.0;
+    deque_push(&job.deques[0], v);
+
+    thread_pool_run(pool, backward_worker, &job);
+    backward_job_free(&job);
+}
@@ -0,0 +1,404 @@
+#include "../include/profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+
+#define PROFILE_MAX_REGIONS 16
+#define PROFILE_NAME_SIZE 64
+
+typedef struct ProfileThread ProfileThread;
+
+struct ProfileThread
+{
+    ProfileThread *next;
+    int tid;
+    int depth;
+    size_t bytes;
+    size_t bytes_mark;
+    size_t op_count;
+    ProfileOpStats ops[PROFILE_MAX_OPS];
+    const char *regions[PROFILE_MAX_REGIONS];
+    uint64_t region_starts[PROFILE_MAX_REGIONS];
+    int region_depth;
+};
+
+typedef struct
+{
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+    int tid;
+    char phase;
+    char tensor;
+} ProfileEvent;
+
+/* Every thread keeps its own counters, so the hooks never contend; the
+   readers merge them under the lock. Thread records outlive their threads
+   so a step run on a pool still shows up after the pool is gone. */
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProfileThread *profile_threads = NULL;
+static int profile_thread_count = 0;
+static _Thread_local ProfileThread *profile_self = NULL;
+
+static ProfileEvent *trace_events = NULL;
+static size_t trace_capacity = 0;
+static uint64_t trace_epoch = 0;
+static atomic_int trace_active;
+static atomic_size_t trace_count;
+static atomic_size_t trace_dropped;
+
+static uint64_t profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static ProfileThread *profile_thread(void)
+{
+    if (profile_self)
+        return profile_self;
+
+    ProfileThread *self = calloc(1, sizeof(ProfileThread));
+    if (!self)
+        return NULL;
+
+    pthread_mutex_lock(&profile_lock);
+    self->tid = profile_thread_count++;
+    self->next = profile_threads;
+    profile_threads = self;
+    pthread_mutex_unlock(&profile_lock);
+
+    profile_self = self;
+    return self;
+}
+
+/* Symbols are string literals, so the pointer check almost always hits;
+   strcmp only matters when two translation units spell the same symbol. */
+static ProfileOpStats *profile_slot(ProfileThread *self, const char *op, int tensor)
+{
+    for (size_t i = 0; i < self->op_count; i++)
+    {
+        if (self->ops[i].op == op && self->ops[i].tensor == tensor)
+            return &self->ops[i];
+    }
+    for (size_t i = 0; i < self->op_count; i++)
+    {
+        if (self->ops[i].tensor == tensor && strcmp(self->ops[i].op, op) == 0)
+            return &self->ops[i];
+    }
+    if (self->op_count == PROFILE_MAX_OPS)
+        return NULL;
+
+    ProfileOpStats *slot = &self->ops[self->op_count++];
+    memset(slot, 0, sizeof(*slot));
+    slot->op = op;
+    slot->tensor = tensor;
+    return slot;
+}
+
+static void trace_push(const char *name, int tensor, char phase, uint64_t start, uint64_t end, int tid)
+{
+    if (!atomic_load_explicit(&trace_active, memory_order_relaxed))
+        return;
+
+    size_t idx = atomic_fetch_add_explicit(&trace_count, 1, memory_order_relaxed);
+    if (idx >= trace_capacity)
+    {
+        atomic_fetch_add_explicit(&trace_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    trace_events[idx] = (ProfileEvent){name, start, end - start, tid, phase, (char)tensor};
+}
+
+static void profile_op_name(const char *op, int tensor, char *buf, size_t size)
+{
+    if (op[0] == '\0')
+        op = "leaf";
+    else if (strcmp(op, "?") == 0)
+        op = "custom";
+    snprintf(buf, size, tensor ? "tensor:%s" : "%s", op);
+}
+
+int profile_enabled(void)
+{
+#ifdef GIGAGRAD_PROFILE
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+uint64_t profile_forward_begin(void)
+{
+    ProfileThread *self = profile_thread();
+    if (!self || self->depth++ > 0)
+        return 0;
+
+    self->bytes_mark = self->bytes;
+    return profile_now();
+}
+
+/* Ops built from other ops (a tensor allocating its Value node, softmax
+   creating n outputs) are charged once, to the outermost call. */
+void profile_forward_end(uint64_t start, const char *op, int tensor, size_t nodes)
+{
+    ProfileThread *self = profile_self;
+    if (!self || --self->depth > 0)
+        return;
+
+    uint64_t end = profile_now();
+    ProfileOpStats *slot = profile_slot(self, op, tensor);
+    if (slot)
+    {
+        slot->nodes += nodes;
+        slot->forward_ns += end - start;
+        slot->bytes += self->bytes - self->bytes_mark;
+    }
+    trace_push(op, tensor, 'F', start, end, self->tid);
+}
+
+void profile_run_backward(Value *node)
+{
+    ProfileThread *self = profile_thread();
+    uint64_t start = profile_now();
+    node->backward(node);
+    uint64_t end = profile_now();
+    if (!self)
+        return;
+
+    const char *op = value_get_op_symbol(node);
+    int tensor = (node->flags & VALUE_FLAG_TENSOR) != 0;
+    ProfileOpStats *slot = profile_slot(self, op, tensor);
+    if (slot)
+    {
+        slot->backward_calls++;
+        slot->backward_ns += end - start;
+    }
+    trace_push(op, tensor, 'B', start, end, self->tid);
+}
+
+void profile_alloc(size_t bytes)
+{
+    ProfileThread *self = profile_thread();
+    if (self)
+        self->bytes += bytes;
+}
+
+void profile_region_begin(const char *name)
+{
+    if (!profile_enabled())
+        return;
+
+    ProfileThread *self = profile_thread();
+    if (!self)
+        return;
+    if (self->region_depth < PROFILE_MAX_REGIONS)
+    {
+        self->regions[self->region_depth] = name;
+        self->region_starts[self->region_depth] = profile_now();
+    }
+    self->region_depth++;
+}
+
+void profile_region_end(void)
+{
+    ProfileThread *self = profile_self;
+    if (!self || self->region_depth == 0)
+        return;
+
+    int depth = --self->region_depth;
+    if (depth < PROFILE_MAX_REGIONS)
+        trace_push(self->regions[depth], 0, 'R', self->region_starts[depth], profile_now(), self->tid);
+}
+
+void profile_reset(void)
+{
+    pthread_mutex_lock(&profile_lock);
+    for (ProfileThread *t = profile_threads; t; t = t->next)
+        t->op_count = 0;
+    atomic_store(&trace_count, 0);
+    atomic_store(&trace_dropped, 0);
+    trace_epoch = profile_now();
+    pthread_mutex_unlock(&profile_lock);
+}
+
+size_t profile_get_stats(ProfileOpStats *stats, size_t max)
+{
+    size_t count = 0;
+    if (!stats)
+        return 0;
+
+    pthread_mutex_lock(&profile_lock);
+    for (ProfileThread *t = profile_threads; t; t = t->next)
+    {
+        for (size_t i = 0; i < t->op_count; i++)
+        {
+            const ProfileOpStats *src = &t->ops[i];
+            size_t j = 0;
+            while (j < count && (stats[j].tensor != src->tensor || strcmp(stats[j].op, src->op) != 0))
+                j++;
+            if (j == count)
+            {
+                if (count == max)
+                    continue;
+                stats[count] = *src;
+                count++;
+                continue;
+            }
+            stats[j].nodes += src->nodes;
+            stats[j].forward_ns += src->forward_ns;
+            stats[j].backward_calls += src->backward_calls;
+            stats[j].backward_ns += src->backward_ns;
+            stats[j].bytes += src->bytes;
+        }
+    }
+    pthread_mutex_unlock(&profile_lock);
+    return count;
+}
+
+static int compare_total_time(const void *a, const void *b)
+{
+    const ProfileOpStats *x = a, *y = b;
+    uint64_t tx = x->forward_ns + x->backward_ns, ty = y->forward_ns + y->backward_ns;
+    return tx < ty ? 1 : tx > ty ? -1 : 0;
+}
+
+void profile_print(FILE *out)
+{
+    ProfileOpStats stats[PROFILE_MAX_OPS];
+    size_t count = profile_get_stats(stats, PROFILE_MAX_OPS);
+    char name[PROFILE_NAME_SIZE];
+
+    if (!profile_enabled())
+        fprintf(out, "Profiling disabled (build with PROFILE=1)\n");
+    if (count == 0)
+        return;
+
+    qsort(stats, count, sizeof(stats[0]), compare_total_time);
+    fprintf(out, "%-22s %10s %12s %10s %12s %12s\n",
+            "op", "nodes", "forward ms", "bw calls", "backward ms", "bytes");
+    for (size_t i = 0; i < count; i++)
+    {
+        profile_op_name(stats[i].op, stats[i].tensor, name, sizeof(name));
+        fprintf(out, "%-22s %10zu %12.3f %10zu %12.3f %12zu\n", name, stats[i].nodes,
+                stats[i].forward_ns * 1e-6, stats[i].backward_calls, stats[i].backward_ns * 1e-6,
+                stats[i].bytes);
+    }
+}
+
+int profile_trace_begin(size_t max_events)
+{
+    if (max_events == 0)
+        max_events = PROFILE_DEFAULT_EVENTS;
+
+    pthread_mutex_lock(&profile_lock);
+    if (max_events != trace_capacity)
+    {
+        ProfileEvent *events = realloc(trace_events, max_events * sizeof(ProfileEvent));
+        if (!events)
+        {
+            pthread_mutex_unlock(&profile_lock);
+            fprintf(stderr, "[ERROR] Memory allocation failed for profile trace\n");
+            return 0;
+        }
+        trace_events = events;
+        trace_capacity = max_events;
+    }
+    atomic_store(&trace_count, 0);
+    atomic_store(&trace_dropped, 0);
+    trace_epoch = profile_now();
+    atomic_store(&trace_active, 1);
+    pthread_mutex_unlock(&profile_lock);
+    return 1;
+}
+
+void profile_trace_end(void)
+{
+    atomic_store(&trace_active, 0);
+}
+
+size_t profile_trace_dropped(void)
+{
+    return atomic_load(&trace_dropped);
+}
+
+static FILE *profile_open(const char *filename)
+{
+    struct stat st = {0};
+    char filepath[256];
+
+    if (stat("output", &st) == -1 && mkdir("output", 0700) == -1)
+    {
+        perror("Failed to create output directory");
+        return NULL;
+    }
+
+    snprintf(filepath, sizeof(filepath), "output/%s", filename);
+    FILE *f = fopen(filepath, "w");
+    if (!f)
+        fprintf(stderr, "[ERROR] Could not open %s for writing\n", filepath);
+    return f;
+}
+
+/* Chrome trace event format: load the file in chrome://tracing or
+   ui.perfetto.dev. Every event is a complete ("X") event in microseconds. */
+int profile_write_trace(const char *filename)
+{
+    static const char *categories[] = {"forward", "backward", "region"};
+    char name[PROFILE_NAME_SIZE];
+
+    FILE *f = profile_open(filename);
+    if (!f)
+        return 0;
+
+    size_t count = atomic_load(&trace_count);
+    if (count > trace_capacity)
+        count = trace_capacity;
+
+    fprintf(f, "{\"traceEvents\": [\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        const ProfileEvent *e = &trace_events[i];
+        const char *category = categories[e->phase == 'F' ? 0 : e->phase == 'B' ? 1 : 2];
+        if (e->phase == 'R')
+            snprintf(name, sizeof(name), "%s", e->name);
+        else
+            profile_op_name(e->name, e->tensor, name, sizeof(name));
+
+        fprintf(f, "  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                   "\"pid\": 1, \"tid\": %d}%s\n",
+                name, category, (e->start - trace_epoch) * 1e-3, e->duration * 1e-3, e->tid,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(f, "], \"displayTimeUnit\": \"ns\"}\n");
+    fclose(f);
+    return 1;
+}
+
+/* Folded stacks for flamegraph.pl / speedscope: one "phase;op ns" line per
+   op, built from the aggregate counters so it needs no trace capture. */
+int profile_write_folded(const char *filename)
+{
+    ProfileOpStats stats[PROFILE_MAX_OPS];
+    size_t count = profile_get_stats(stats, PROFILE_MAX_OPS);
+    char name[PROFILE_NAME_SIZE];
+
+    FILE *f = profile_open(filename);
+    if (!f)
+        return 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        profile_op_name(stats[i].op, stats[i].tensor, name, sizeof(name));
+        if (stats[i].forward_ns)
+            fprintf(f, "forward;%s %llu\n", name, (unsigned long long)stats[i].forward_ns);
+        if (stats[i].backward_ns)
+            fprintf(f, "backward;%s %llu\n", name, (unsigned long long)stats[i].backward_ns);
+    }
+    fclose(f);
+    return 1;
+}
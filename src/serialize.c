@@ -0,0 +1,518 @@
+#include "../include/serialize.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MODEL_CHUNK 512
+#define MODEL_ROUND_UP(x) (((x) + MODEL_ALIGN - 1) & ~(uint64_t)(MODEL_ALIGN - 1))
+
+_Static_assert(sizeof(ModelHeader) == 64, "ModelHeader must stay 64 bytes");
+_Static_assert(sizeof(ModelSection) == 128, "ModelSection must stay 128 bytes");
+
+typedef struct
+{
+    ModelSection meta;
+    Value **values;
+    const void *data;
+    Optimizer *opt;
+} ModelEntry;
+
+struct ModelWriter
+{
+    ModelEntry *entries;
+    size_t count;
+    size_t capacity;
+};
+
+struct ModelFile
+{
+    unsigned char *map;
+    size_t size;
+    const ModelHeader *header;
+    const ModelSection *sections;
+};
+
+/* FNV-1a over 64-bit words; the tail is zero-padded. Cheap enough to run on
+   every save, and only checked on load when model_verify is called. */
+static uint64_t model_hash(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + 8 * i, 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    if (size % 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, bytes + 8 * words, size % 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#define MODEL_HASH_SEED 0xcbf29ce484222325ull
+
+ModelWriter *model_writer_create(void)
+{
+    return calloc(1, sizeof(ModelWriter));
+}
+
+void model_writer_free(ModelWriter *w)
+{
+    if (!w)
+        return;
+    free(w->entries);
+    free(w);
+}
+
+static ModelEntry *model_writer_entry(ModelWriter *w, const char *name, ModelSectionKind kind,
+                                      size_t elem_size, size_t count)
+{
+    if (!w || !name || strlen(name) >= MODEL_NAME_SIZE)
+    {
+        fprintf(stderr, "[ERROR] Invalid section name for model file\n");
+        return NULL;
+    }
+    for (size_t i = 0; i < w->count; i++)
+    {
+        if (strcmp(w->entries[i].meta.name, name) == 0)
+        {
+            fprintf(stderr, "[ERROR] Duplicate model section '%s'\n", name);
+            return NULL;
+        }
+    }
+
+    if (w->count == w->capacity)
+    {
+        size_t capacity = w->capacity ? w->capacity * 2 : 8;
+        ModelEntry *entries = realloc(w->entries, capacity * sizeof(ModelEntry));
+        if (!entries)
+        {
+            fprintf(stderr, "[ERROR] Memory allocation failed for model writer\n");
+            return NULL;
+        }
+        w->entries = entries;
+        w->capacity = capacity;
+    }
+
+    ModelEntry *e = &w->entries[w->count++];
+    memset(e, 0, sizeof(ModelEntry));
+    strcpy(e->meta.name, name);
+    e->meta.kind = kind;
+    e->meta.elem_size = (uint32_t)elem_size;
+    e->meta.ndim = 1;
+    e->meta.shape[0] = count;
+    e->meta.count = count;
+    return e;
+}
+
+int model_writer_add_values(ModelWriter *w, const char *name, Value **values, size_t count)
+{
+    if (!values || count == 0)
+        return 0;
+
+    ModelEntry *e = model_writer_entry(w, name, MODEL_SECTION_VALUES, sizeof(double), count);
+    if (!e)
+        return 0;
+    e->values = values;
+    return 1;
+}
+
+int model_writer_add_tensor(ModelWriter *w, const char *name, Tensor *t)
+{
+    if (!t || !tensor_is_contiguous(t))
+    {
+        fprintf(stderr, "[ERROR] model_writer_add_tensor requires a contiguous tensor\n");
+        return 0;
+    }
+
+    ModelEntry *e = model_writer_entry(w, name, MODEL_SECTION_TENSOR, sizeof(real_t), t->size);
+    if (!e)
+        return 0;
+    e->data = t->data;
+    e->meta.ndim = (uint32_t)t->ndim;
+    for (int i = 0; i < t->ndim; i++)
+        e->meta.shape[i] = t->shape[i];
+    return 1;
+}
+
+/* The optimizer state is read at save time, so one writer can be reused
+   for every checkpoint of a run. */
+int model_writer_add_optim(ModelWriter *w, const char *name, Optimizer *opt)
+{
+    if (!opt)
+        return 0;
+
+    ModelEntry *e = model_writer_entry(w, name, MODEL_SECTION_OPTIM, sizeof(double), optim_state_size(opt));
+    if (!e)
+        return 0;
+    e->opt = opt;
+    return 1;
+}
+
+static int model_write_values(FILE *f, ModelEntry *e)
+{
+    double chunk[MODEL_CHUNK];
+    for (size_t i = 0; i < e->meta.count; i += MODEL_CHUNK)
+    {
+        size_t n = e->meta.count - i < MODEL_CHUNK ? e->meta.count - i : MODEL_CHUNK;
+        for (size_t j = 0; j < n; j++)
+            chunk[j] = e->values[i + j]->data;
+        e->meta.checksum = model_hash(e->meta.checksum, chunk, n * sizeof(double));
+        if (fwrite(chunk, sizeof(double), n, f) != n)
+            return 0;
+    }
+    return 1;
+}
+
+static int model_write_payload(FILE *f, ModelEntry *e)
+{
+    e->meta.checksum = MODEL_HASH_SEED;
+    if (e->values)
+        return model_write_values(f, e);
+
+    size_t bytes = e->meta.count * e->meta.elem_size;
+    if (e->opt)
+    {
+        double *state = malloc(bytes);
+        int ok = state && optim_get_state(e->opt, state, e->meta.count);
+        if (ok)
+        {
+            e->meta.checksum = model_hash(e->meta.checksum, state, bytes);
+            ok = fwrite(state, 1, bytes, f) == bytes;
+        }
+        free(state);
+        return ok;
+    }
+
+    e->meta.checksum = model_hash(e->meta.checksum, e->data, bytes);
+    return fwrite(e->data, 1, bytes, f) == bytes;
+}
+
+static int model_pad(FILE *f, uint64_t offset)
+{
+    static const unsigned char zeros[MODEL_ALIGN];
+    long pos = ftell(f);
+    if (pos < 0 || (uint64_t)pos > offset)
+        return 0;
+    for (uint64_t gap = offset - (uint64_t)pos; gap > 0;)
+    {
+        size_t n = gap < MODEL_ALIGN ? (size_t)gap : MODEL_ALIGN;
+        if (fwrite(zeros, 1, n, f) != n)
+            return 0;
+        gap -= n;
+    }
+    return 1;
+}
+
+/* The file is written next to its destination and renamed into place, so
+   a crash mid-save leaves the previous checkpoint intact. */
+int model_writer_save(ModelWriter *w, const char *path, uint64_t epoch, uint64_t step)
+{
+    if (!w || !path)
+        return 0;
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "[ERROR] Could not open %s for writing\n", tmp_path);
+        return 0;
+    }
+
+    for (size_t i = 0; i < w->count; i++)
+    {
+        ModelEntry *e = &w->entries[i];
+        if (e->opt)
+            e->meta.count = e->meta.shape[0] = optim_state_size(e->opt);
+    }
+
+    uint64_t offset = MODEL_ROUND_UP(sizeof(ModelHeader) + w->count * sizeof(ModelSection));
+    for (size_t i = 0; i < w->count; i++)
+    {
+        ModelSection *meta = &w->entries[i].meta;
+        meta->offset = offset;
+        offset = MODEL_ROUND_UP(offset + meta->count * meta->elem_size);
+    }
+
+    ModelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    header.version = MODEL_VERSION;
+    header.byte_order = MODEL_BYTE_ORDER;
+    header.epoch = epoch;
+    header.step = step;
+    header.section_count = w->count;
+    header.file_size = offset;
+
+    int ok = 1;
+    for (size_t i = 0; ok && i < w->count; i++)
+        ok = model_pad(f, w->entries[i].meta.offset) && model_write_payload(f, &w->entries[i]);
+    ok = ok && model_pad(f, offset);
+
+    /* Checksums are only known once the payloads are out, so the header and
+       section table go in last. */
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1;
+    for (size_t i = 0; ok && i < w->count; i++)
+        ok = fwrite(&w->entries[i].meta, sizeof(ModelSection), 1, f) == 1;
+
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (ok && rename(tmp_path, path) != 0)
+        ok = 0;
+    if (!ok)
+    {
+        fprintf(stderr, "[ERROR] Failed to write model file %s\n", path);
+        remove(tmp_path);
+    }
+    return ok;
+}
+
+static int model_check_section(const ModelSection *s, size_t file_size)
+{
+    if (memchr(s->name, '\0', MODEL_NAME_SIZE) == NULL)
+        return 0;
+    if (s->kind < MODEL_SECTION_VALUES || s->kind > MODEL_SECTION_OPTIM)
+        return 0;
+    if (s->elem_size != sizeof(double) && s->elem_size != sizeof(float))
+        return 0;
+    /* Only tensors may be stored in float; the other loaders read doubles. */
+    if (s->kind != MODEL_SECTION_TENSOR && s->elem_size != sizeof(double))
+        return 0;
+    if (s->ndim < 1 || s->ndim > TENSOR_MAX_DIMS || s->offset % MODEL_ALIGN)
+        return 0;
+    if (s->offset > file_size || s->count > (file_size - s->offset) / s->elem_size)
+        return 0;
+
+    uint64_t elements = 1;
+    for (uint32_t i = 0; i < s->ndim; i++)
+    {
+        if (s->shape[i] && elements > s->count / s->shape[i])
+            return 0;
+        elements *= s->shape[i];
+    }
+    return elements == s->count;
+}
+
+ModelFile *model_open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "[ERROR] Could not open model file %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ModelHeader))
+    {
+        fprintf(stderr, "[ERROR] %s is not a model file\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    /* A private writable mapping: pages are shared with the page cache until
+       a caller writes to a mapped tensor, which then gets its own copy. */
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "[ERROR] Could not map model file %s\n", path);
+        return NULL;
+    }
+
+    const ModelHeader *header = map;
+    const char *problem = NULL;
+    if (memcmp(header->magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0)
+        problem = "bad magic";
+    else if (header->byte_order != MODEL_BYTE_ORDER)
+        problem = "written on a machine with a different byte order";
+    else if (header->version != MODEL_VERSION)
+        problem = "unsupported version";
+    else if (header->file_size != size)
+        problem = "truncated";
+    else if (header->section_count > (size - sizeof(ModelHeader)) / sizeof(ModelSection))
+        problem = "corrupt section table";
+
+    const ModelSection *sections = (const ModelSection *)(header + 1);
+    for (uint64_t i = 0; !problem && i < header->section_count; i++)
+    {
+        if (!model_check_section(&sections[i], size))
+            problem = "corrupt section table";
+    }
+
+    ModelFile *m = problem ? NULL : malloc(sizeof(ModelFile));
+    if (!m)
+    {
+        fprintf(stderr, "[ERROR] Could not load model file %s: %s\n", path, problem ? problem : "out of memory");
+        munmap(map, size);
+        return NULL;
+    }
+
+    m->map = map;
+    m->size = size;
+    m->header = header;
+    m->sections = sections;
+    return m;
+}
+
+void model_close(ModelFile *m)
+{
+    if (!m)
+        return;
+    munmap(m->map, m->size);
+    free(m);
+}
+
+/* Reads every page of the file; skip it when startup latency matters. */
+int model_verify(ModelFile *m)
+{
+    if (!m)
+        return 0;
+
+    for (uint64_t i = 0; i < m->header->section_count; i++)
+    {
+        const ModelSection *s = &m->sections[i];
+        uint64_t hash = model_hash(MODEL_HASH_SEED, m->map + s->offset, s->count * s->elem_size);
+        if (hash != s->checksum)
+        {
+            fprintf(stderr, "[ERROR] Checksum mismatch in model section '%s'\n", s->name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint64_t model_epoch(ModelFile *m)
+{
+    return m ? m->header->epoch : 0;
+}
+
+uint64_t model_step(ModelFile *m)
+{
+    return m ? m->header->step : 0;
+}
+
+const ModelSection *model_find(ModelFile *m, const char *name)
+{
+    if (!m || !name)
+        return NULL;
+
+    for (uint64_t i = 0; i < m->header->section_count; i++)
+    {
+        if (strcmp(m->sections[i].name, name) == 0)
+            return &m->sections[i];
+    }
+    return NULL;
+}
+
+const void *model_section_data(ModelFile *m, const ModelSection *section)
+{
+    return m && section ? m->map + section->offset : NULL;
+}
+
+static const ModelSection *model_expect(ModelFile *m, const char *name, ModelSectionKind kind, size_t count)
+{
+    const ModelSection *s = model_find(m, name);
+    if (!s)
+    {
+        fprintf(stderr, "[ERROR] Model file has no section '%s'\n", name);
+        return NULL;
+    }
+    if (s->kind != kind || (count && s->count != count))
+    {
+        fprintf(stderr, "[ERROR] Model section '%s' does not match (kind %u, %llu elements)\n",
+                name, s->kind, (unsigned long long)s->count);
+        return NULL;
+    }
+    return s;
+}
+
+int model_load_values(ModelFile *m, const char *name, Value **values, size_t count)
+{
+    const ModelSection *s = model_expect(m, name, MODEL_SECTION_VALUES, count);
+    if (!s || !values)
+        return 0;
+
+    const double *data = model_section_data(m, s);
+    for (size_t i = 0; i < count; i++)
+        values[i]->data = data[i];
+    return 1;
+}
+
+int model_load_tensor(ModelFile *m, const char *name, Tensor *t)
+{
+    if (!t || !tensor_is_contiguous(t))
+    {
+        fprintf(stderr, "[ERROR] model_load_tensor requires a contiguous tensor\n");
+        return 0;
+    }
+
+    const ModelSection *s = model_expect(m, name, MODEL_SECTION_TENSOR, t->size);
+    if (!s)
+        return 0;
+
+    int same_shape = s->ndim == (uint32_t)t->ndim;
+    for (int i = 0; same_shape && i < t->ndim; i++)
+        same_shape = s->shape[i] == t->shape[i];
+    if (!same_shape)
+    {
+        fprintf(stderr, "[ERROR] Model section '%s' has a different shape than the tensor\n", name);
+        return 0;
+    }
+
+    const void *data = model_section_data(m, s);
+    if (s->elem_size == sizeof(real_t))
+    {
+        memcpy(t->data, data, t->size * sizeof(real_t));
+    }
+    else if (s->elem_size == sizeof(double))
+    {
+        for (size_t i = 0; i < t->size; i++)
+            t->data[i] = (real_t)((const double *)data)[i];
+    }
+    else
+    {
+        for (size_t i = 0; i < t->size; i++)
+            t->data[i] = (real_t)((const float *)data)[i];
+    }
+    return 1;
+}
+
+int model_load_optim(ModelFile *m, const char *name, Optimizer *opt)
+{
+    const ModelSection *s = model_expect(m, name, MODEL_SECTION_OPTIM, optim_state_size(opt));
+    if (!s)
+        return 0;
+    return optim_set_state(opt, model_section_data(m, s), s->count);
+}
+
+/* Zero-copy: the tensor points straight into the mapping, so it must be
+   freed before model_close and the file's precision must match real_t. */
+Tensor *model_map_tensor(ModelFile *m, const char *name)
+{
+    const ModelSection *s = model_expect(m, name, MODEL_SECTION_TENSOR, 0);
+    if (!s)
+        return NULL;
+    if (s->elem_size != sizeof(real_t))
+    {
+        fprintf(stderr, "[ERROR] Model section '%s' holds %u-byte elements, this build uses %s; "
+                        "use model_load_tensor to convert\n",
+                name, s->elem_size, REAL_NAME);
+        return NULL;
+    }
+
+    size_t shape[TENSOR_MAX_DIMS];
+    for (uint32_t i = 0; i < s->ndim; i++)
+        shape[i] = s->shape[i];
+    return tensor_wrap((real_t *)(m->map + s->offset), shape, (int)s->ndim);
+}
@@ -0,0 +1,128 @@
+#include "../include/tape.h"
+#include <stdlib.h>
+
+#define TAPE_ALIGN 16
+#define TAPE_ALIGN_UP(n) (((n) + (TAPE_ALIGN - 1)) & ~(size_t)(TAPE_ALIGN - 1))
+#define TAPE_HEADER_SIZE TAPE_ALIGN_UP(sizeof(TapeBlock))
+
+static _Thread_local Tape *active_tape = NULL;
+
+static TapeBlock *tape_block_create(size_t size)
+{
+    TapeBlock *block = malloc(TAPE_HEADER_SIZE + size);
+    if (!block)
+        return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+Tape *tape_create(size_t block_size)
+{
+    Tape *tape = malloc(sizeof(Tape));
+    if (!tape)
+        return NULL;
+
+    tape->block_size = TAPE_ALIGN_UP(block_size ? block_size : TAPE_DEFAULT_BLOCK_SIZE);
+    tape->head = tape_block_create(tape->block_size);
+    if (!tape->head)
+    {
+        free(tape);
+        return NULL;
+    }
+    tape->current = tape->head;
+    tape->bytes_used = 0;
+    tape->bytes_reserved = tape->block_size;
+    return tape;
+}
+
+void tape_free(Tape *tape)
+{
+    if (!tape)
+        return;
+
+    if (active_tape == tape)
+        active_tape = NULL;
+
+    TapeBlock *block = tape->head;
+    while (block)
+    {
+        TapeBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(tape);
+}
+
+void tape_reset(Tape *tape)
+{
+    if (!tape)
+        return;
+
+    for (TapeBlock *block = tape->head; block; block = block->next)
+        block->used = 0;
+    tape->current = tape->head;
+    tape->bytes_used = 0;
+}
+
+void *tape_alloc(Tape *tape, size_t size)
+{
+    if (!tape)
+        return NULL;
+
+    size = TAPE_ALIGN_UP(size ? size : 1);
+
+    TapeBlock *block = tape->current;
+    while (block->size - block->used < size)
+    {
+        TapeBlock *next = block->next;
+        if (!next || next->size < size)
+        {
+            size_t block_size = size > tape->block_size ? size : tape->block_size;
+            TapeBlock *fresh = tape_block_create(block_size);
+            if (!fresh)
+                return NULL;
+            fresh->next = next;
+            block->next = fresh;
+            tape->bytes_reserved += block_size;
+            next = fresh;
+        }
+        block = next;
+        tape->current = block;
+    }
+
+    void *ptr = (char *)block + TAPE_HEADER_SIZE + block->used;
+    block->used += size;
+    tape->bytes_used += size;
+    return ptr;
+}
+
+int tape_owns(Tape *tape, const void *ptr)
+{
+    if (!tape)
+        return 0;
+
+    for (TapeBlock *block = tape->head; block; block = block->next)
+    {
+        const char *base = (const char *)block + TAPE_HEADER_SIZE;
+        if ((const char *)ptr >= base && (const char *)ptr < base + block->used)
+            return 1;
+    }
+    return 0;
+}
+
+void tape_begin(Tape *tape)
+{
+    active_tape = tape;
+}
+
+void tape_end(void)
+{
+    active_tape = NULL;
+}
+
+Tape *tape_active(void)
+{
+    return active_tape;
+}
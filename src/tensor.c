@@ -0,0 +1,708 @@
+#include "../include/tensor.h"
+#include "../include/gemm.h"
+#include "../include/profile.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+
+#define TENSOR(v) ((Tensor *)(v)->backward_ctx)
+
+static Tensor *tensor_new(const size_t *shape, int ndim, size_t prev_count,
+                          BackwardFn backward, const char *op)
+{
+    if (!shape || ndim < 1 || ndim > TENSOR_MAX_DIMS)
+    {
+        fprintf(stderr, "[ERROR] Invalid tensor rank %d\n", ndim);
+        return NULL;
+    }
+
+    Value *node = value_create(0.0);
+    if (!node)
+        return NULL;
+    node->flags |= VALUE_FLAG_TENSOR;
+
+    Tensor *t = value_alloc_ctx(node, sizeof(Tensor));
+    if (!t)
+    {
+        value_free(node);
+        return NULL;
+    }
+
+    t->node = node;
+    t->base = NULL;
+    t->op = op;
+    t->grad_lock = 0;
+    t->ndim = ndim;
+    t->size = 1;
+    for (int i = ndim - 1; i >= 0; i--)
+    {
+        t->shape[i] = shape[i];
+        t->strides[i] = t->size;
+        t->size *= shape[i];
+    }
+
+    t->data = value_alloc_owned(node, t->size * sizeof(real_t));
+    t->grad = NULL;
+    if (!t->data)
+    {
+        tensor_free(t);
+        return NULL;
+    }
+    if (!value_grad_enabled())
+        return t;
+
+    t->grad = value_alloc_owned(node, t->size * sizeof(real_t));
+    if (!t->grad || (prev_count && !value_alloc_prev(node, prev_count)))
+    {
+        tensor_free(t);
+        return NULL;
+    }
+
+    memset(t->grad, 0, t->size * sizeof(real_t));
+    node->backward = backward;
+    return t;
+}
+
+static Tensor *build_tensor_create(const size_t *shape, int ndim)
+{
+    Tensor *t = tensor_new(shape, ndim, 0, NULL, "");
+    if (!t)
+        return NULL;
+
+    memset(t->data, 0, t->size * sizeof(real_t));
+    return t;
+}
+
+Tensor *tensor_create(const size_t *shape, int ndim)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_create(shape, ndim);
+    PROFILE_TENSOR_END("");
+    return out;
+}
+
+static Tensor *build_tensor_from_data(const real_t *data, const size_t *shape, int ndim)
+{
+    Tensor *t = tensor_new(shape, ndim, 0, NULL, "");
+    if (!t)
+        return NULL;
+
+    memcpy(t->data, data, t->size * sizeof(real_t));
+    return t;
+}
+
+Tensor *tensor_from_data(const real_t *data, const size_t *shape, int ndim)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_from_data(data, shape, ndim);
+    PROFILE_TENSOR_END("");
+    return out;
+}
+
+/* A tensor over storage owned by someone else, such as a mapped model file.
+   It is its own base, so tensor_free leaves the data alone, and it has no
+   grad, so it is read-only as far as backward is concerned. */
+static Tensor *build_tensor_wrap(real_t *data, const size_t *shape, int ndim)
+{
+    if (!data || !shape || ndim < 1 || ndim > TENSOR_MAX_DIMS)
+    {
+        fprintf(stderr, "[ERROR] Invalid arguments to tensor_wrap\n");
+        return NULL;
+    }
+
+    Value *node = value_create(0.0);
+    if (!node)
+        return NULL;
+    node->flags |= VALUE_FLAG_TENSOR;
+
+    Tensor *t = value_alloc_ctx(node, sizeof(Tensor));
+    if (!t)
+    {
+        value_free(node);
+        return NULL;
+    }
+
+    memset(t, 0, sizeof(Tensor));
+    t->node = node;
+    t->base = t;
+    t->op = "";
+    t->data = data;
+    t->ndim = ndim;
+    t->size = 1;
+    for (int i = ndim - 1; i >= 0; i--)
+    {
+        t->shape[i] = shape[i];
+        t->strides[i] = t->size;
+        t->size *= shape[i];
+    }
+    return t;
+}
+
+Tensor *tensor_wrap(real_t *data, const size_t *shape, int ndim)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_wrap(data, shape, ndim);
+    PROFILE_TENSOR_END("");
+    return out;
+}
+
+void tensor_free(Tensor *t)
+{
+    if (!t || (t->node->flags & VALUE_FLAG_TAPE))
+        return;
+
+    if (!t->base)
+    {
+        free(t->data);
+        free(t->grad);
+    }
+    value_free(t->node);
+}
+
+int tensor_is_contiguous(Tensor *t)
+{
+    size_t expected = 1;
+    for (int i = t->ndim - 1; i >= 0; i--)
+    {
+        if (t->shape[i] != 1 && t->strides[i] != expected)
+            return 0;
+        expected *= t->shape[i];
+    }
+    return 1;
+}
+
+void tensor_zero_grad(Tensor *t)
+{
+    if (t && t->grad)
+        memset(t->grad, 0, t->size * sizeof(real_t));
+}
+
+const char *tensor_get_op_symbol(Value *node)
+{
+    return TENSOR(node)->op;
+}
+
+static int tensor_lock_grad(Tensor *t)
+{
+    if (!t->grad)
+        return 0;
+    if (!value_atomic_grads())
+        return 1;
+
+    Tensor *owner = t->base ? t->base : t;
+    while (__atomic_exchange_n(&owner->grad_lock, 1, __ATOMIC_ACQUIRE))
+        sched_yield();
+    return 1;
+}
+
+static void tensor_unlock_grad(Tensor *t)
+{
+    if (!value_atomic_grads())
+        return;
+
+    Tensor *owner = t->base ? t->base : t;
+    __atomic_store_n(&owner->grad_lock, 0, __ATOMIC_RELEASE);
+}
+
+static int tensor_check_contiguous(Tensor *t, const char *op)
+{
+    if (tensor_is_contiguous(t))
+        return 1;
+    fprintf(stderr, "[ERROR] %s requires a contiguous tensor\n", op);
+    return 0;
+}
+
+static Tensor *build_tensor_transpose(Tensor *t)
+{
+    if (!t || t->ndim != 2)
+    {
+        fprintf(stderr, "[ERROR] tensor_transpose expects a 2-D tensor\n");
+        return NULL;
+    }
+
+    Value *node = value_create(0.0);
+    if (!node)
+        return NULL;
+    node->flags |= VALUE_FLAG_TENSOR;
+
+    Tensor *view = value_alloc_ctx(node, sizeof(Tensor));
+    if (!view || (value_grad_enabled() && !value_alloc_prev(node, 1)))
+    {
+        value_free(node);
+        return NULL;
+    }
+
+    *view = *t;
+    view->node = node;
+    view->base = t->base ? t->base : t;
+    view->op = "T";
+    view->shape[0] = t->shape[1];
+    view->shape[1] = t->shape[0];
+    view->strides[0] = t->strides[1];
+    view->strides[1] = t->strides[0];
+    if (node->prev)
+        node->prev[0] = t->node;
+    return view;
+}
+
+Tensor *tensor_transpose(Tensor *t)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_transpose(t);
+    PROFILE_TENSOR_END("T");
+    return out;
+}
+
+static void backward_tensor_add(Value *self)
+{
+    Tensor *out = TENSOR(self);
+    Tensor *a = TENSOR(self->prev[0]);
+    Tensor *b = TENSOR(self->prev[1]);
+
+    if (tensor_lock_grad(a))
+    {
+        for (size_t i = 0; i < out->size; i++)
+            a->grad[i] += out->grad[i];
+        tensor_unlock_grad(a);
+    }
+
+    if (tensor_lock_grad(b))
+    {
+        for (size_t i = 0; i < out->size; i++)
+            b->grad[i % b->size] += out->grad[i];
+        tensor_unlock_grad(b);
+    }
+}
+
+static void backward_tensor_mul(Value *self)
+{
+    Tensor *out = TENSOR(self);
+    Tensor *a = TENSOR(self->prev[0]);
+    Tensor *b = TENSOR(self->prev[1]);
+
+    if (tensor_lock_grad(a))
+    {
+        for (size_t i = 0; i < out->size; i++)
+            a->grad[i] += b->data[i % b->size] * out->grad[i];
+        tensor_unlock_grad(a);
+    }
+
+    if (tensor_lock_grad(b))
+    {
+        for (size_t i = 0; i < out->size; i++)
+            b->grad[i % b->size] += a->data[i] * out->grad[i];
+        tensor_unlock_grad(b);
+    }
+}
+
+typedef struct
+{
+    int trans;
+    size_t ld;
+} MatLayout;
+
+static int tensor_mat_layout(Tensor *t, MatLayout *layout)
+{
+    if (t->strides[1] == 1 || t->shape[1] == 1)
+    {
+        layout->trans = 0;
+        layout->ld = t->strides[0];
+        return 1;
+    }
+    if (t->strides[0] == 1 || t->shape[0] == 1)
+    {
+        layout->trans = 1;
+        layout->ld = t->strides[1];
+        return 1;
+    }
+    return 0;
+}
+
+static int matmul_into(real_t *c, MatLayout lc,
+                       const real_t *a, MatLayout la, int trans_a,
+                       const real_t *b, MatLayout lb, int trans_b,
+                       size_t m, size_t n, size_t k, int accumulate)
+{
+    trans_a ^= la.trans;
+    trans_b ^= lb.trans;
+
+    if (lc.trans)
+        return gemm(!trans_b, !trans_a, n, m, k, b, lb.ld, a, la.ld, c, lc.ld, accumulate);
+    return gemm(trans_a, trans_b, m, n, k, a, la.ld, b, lb.ld, c, lc.ld, accumulate);
+}
+
+static void backward_tensor_matmul(Value *self)
+{
+    Tensor *out = TENSOR(self);
+    Tensor *a = TENSOR(self->prev[0]);
+    Tensor *b = TENSOR(self->prev[1]);
+    size_t m = a->shape[0], k = a->shape[1], n = b->shape[1];
+    MatLayout la = {0, 0}, lb = {0, 0};
+    MatLayout lg = {0, n};
+
+    tensor_mat_layout(a, &la);
+    tensor_mat_layout(b, &lb);
+
+    if (tensor_lock_grad(a))
+    {
+        matmul_into(a->grad, la, out->grad, lg, 0, b->data, lb, 1, m, k, n, 1);
+        tensor_unlock_grad(a);
+    }
+
+    if (tensor_lock_grad(b))
+    {
+        matmul_into(b->grad, lb, a->data, la, 1, out->grad, lg, 0, k, n, m, 1);
+        tensor_unlock_grad(b);
+    }
+}
+
+static void backward_tensor_relu(Value *self)
+{
+    Tensor *out = TENSOR(self);
+    Tensor *x = TENSOR(self->prev[0]);
+
+    if (tensor_lock_grad(x))
+    {
+        for (size_t i = 0; i < out->size; i++)
+            x->grad[i] += (x->data[i] > 0 ? out->grad[i] : 0);
+        tensor_unlock_grad(x);
+    }
+}
+
+static void backward_tensor_tanh(Value *self)
+{
+    Tensor *out = TENSOR(self);
+    Tensor *x = TENSOR(self->prev[0]);
+
+    if (tensor_lock_grad(x))
+    {
+        for (size_t i = 0; i < out->size; i++)
+            x->grad[i] += (1 - out->data[i] * out->data[i]) * out->grad[i];
+        tensor_unlock_grad(x);
+    }
+}
+
+static void backward_tensor_softmax(Value *self)
+{
+    Tensor *out = TENSOR(self);
+    Tensor *x = TENSOR(self->prev[0]);
+    size_t cols = out->shape[out->ndim - 1];
+    size_t rows = out->size / cols;
+
+    if (tensor_lock_grad(x))
+    {
+        for (size_t r = 0; r < rows; r++)
+        {
+            const real_t *y = out->data + r * cols;
+            const real_t *g = out->grad + r * cols;
+            double dot = 0.0;
+            for (size_t c = 0; c < cols; c++)
+                dot += g[c] * y[c];
+            for (size_t c = 0; c < cols; c++)
+                x->grad[r * cols + c] += y[c] * (g[c] - dot);
+        }
+        tensor_unlock_grad(x);
+    }
+}
+
+static Tensor *tensor_broadcast_op(Tensor *a, Tensor *b, BackwardFn backward, const char *op)
+{
+    if (!a || !b || !tensor_check_contiguous(a, op) || !tensor_check_contiguous(b, op))
+        return NULL;
+    if (b->size != a->size && b->size != a->shape[a->ndim - 1])
+    {
+        fprintf(stderr, "[ERROR] Shape mismatch in tensor %s\n", op);
+        return NULL;
+    }
+
+    Tensor *out = tensor_new(a->shape, a->ndim, 2, backward, op);
+    if (!out || !out->node->prev)
+        return out;
+
+    out->node->prev[0] = a->node;
+    out->node->prev[1] = b->node;
+    return out;
+}
+
+static Tensor *build_tensor_add(Tensor *a, Tensor *b)
+{
+    Tensor *out = tensor_broadcast_op(a, b, backward_tensor_add, "+");
+    if (!out)
+        return NULL;
+
+    for (size_t i = 0; i < out->size; i++)
+        out->data[i] = a->data[i] + b->data[i % b->size];
+    return out;
+}
+
+Tensor *tensor_add(Tensor *a, Tensor *b)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_add(a, b);
+    PROFILE_TENSOR_END("+");
+    return out;
+}
+
+static Tensor *build_tensor_mul(Tensor *a, Tensor *b)
+{
+    Tensor *out = tensor_broadcast_op(a, b, backward_tensor_mul, "*");
+    if (!out)
+        return NULL;
+
+    for (size_t i = 0; i < out->size; i++)
+        out->data[i] = a->data[i] * b->data[i % b->size];
+    return out;
+}
+
+Tensor *tensor_mul(Tensor *a, Tensor *b)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_mul(a, b);
+    PROFILE_TENSOR_END("*");
+    return out;
+}
+
+static Tensor *build_tensor_matmul(Tensor *a, Tensor *b)
+{
+    if (!a || !b || a->ndim != 2 || b->ndim != 2 || a->shape[1] != b->shape[0])
+    {
+        fprintf(stderr, "[ERROR] Shape mismatch in tensor_matmul\n");
+        return NULL;
+    }
+
+    MatLayout la, lb;
+    if (!tensor_mat_layout(a, &la) || !tensor_mat_layout(b, &lb))
+    {
+        fprintf(stderr, "[ERROR] tensor_matmul requires row- or column-major operands\n");
+        return NULL;
+    }
+
+    size_t m = a->shape[0], k = a->shape[1], n = b->shape[1];
+    size_t shape[2] = {m, n};
+    Tensor *out = tensor_new(shape, 2, 2, backward_tensor_matmul, "@");
+    if (!out)
+        return NULL;
+
+    if (out->node->prev)
+    {
+        out->node->prev[0] = a->node;
+        out->node->prev[1] = b->node;
+    }
+
+    MatLayout lc = {0, n};
+    if (!matmul_into(out->data, lc, a->data, la, 0, b->data, lb, 0, m, n, k, 0))
+    {
+        tensor_free(out);
+        return NULL;
+    }
+    return out;
+}
+
+Tensor *tensor_matmul(Tensor *a, Tensor *b)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_matmul(a, b);
+    PROFILE_TENSOR_END("@");
+    return out;
+}
+
+static Tensor *tensor_unary_op(Tensor *x, BackwardFn backward, const char *op)
+{
+    if (!x || !tensor_check_contiguous(x, op))
+        return NULL;
+
+    Tensor *out = tensor_new(x->shape, x->ndim, 1, backward, op);
+    if (!out || !out->node->prev)
+        return out;
+
+    out->node->prev[0] = x->node;
+    return out;
+}
+
+static Tensor *build_tensor_relu(Tensor *x)
+{
+    Tensor *out = tensor_unary_op(x, backward_tensor_relu, "ReLU");
+    if (!out)
+        return NULL;
+
+    for (size_t i = 0; i < out->size; i++)
+        out->data[i] = x->data[i] > 0 ? x->data[i] : 0;
+    return out;
+}
+
+Tensor *tensor_relu(Tensor *x)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_relu(x);
+    PROFILE_TENSOR_END("ReLU");
+    return out;
+}
+
+static Tensor *build_tensor_tanh(Tensor *x)
+{
+    Tensor *out = tensor_unary_op(x, backward_tensor_tanh, "tanh");
+    if (!out)
+        return NULL;
+
+    for (size_t i = 0; i < out->size; i++)
+        out->data[i] = tanh(x->data[i]);
+    return out;
+}
+
+Tensor *tensor_tanh(Tensor *x)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_tanh(x);
+    PROFILE_TENSOR_END("tanh");
+    return out;
+}
+
+static Tensor *build_tensor_softmax(Tensor *x)
+{
+    Tensor *out = tensor_unary_op(x, backward_tensor_softmax, "softmax");
+    if (!out)
+        return NULL;
+
+    size_t cols = x->shape[x->ndim - 1];
+    size_t rows = x->size / cols;
+    for (size_t r = 0; r < rows; r++)
+    {
+        const real_t *in = x->data + r * cols;
+        real_t *y = out->data + r * cols;
+
+        double max_val = in[0];
+        for (size_t c = 1; c < cols; c++)
+        {
+            if (in[c] > max_val)
+                max_val = in[c];
+        }
+
+        double sum = 0.0;
+        for (size_t c = 0; c < cols; c++)
+        {
+            y[c] = exp(in[c] - max_val);
+            sum += y[c];
+        }
+        for (size_t c = 0; c < cols; c++)
+            y[c] /= sum;
+    }
+    return out;
+}
+
+Tensor *tensor_softmax(Tensor *x)
+{
+    PROFILE_FORWARD_BEGIN();
+    Tensor *out = build_tensor_softmax(x);
+    PROFILE_TENSOR_END("softmax");
+    return out;
+}
+
+static void backward_tensor_sum(Value *self)
+{
+    Tensor *t = TENSOR(self->prev[0]);
+
+    if (tensor_lock_grad(t))
+    {
+        for (size_t i = 0; i < t->size; i++)
+            t->grad[i] += self->grad;
+        tensor_unlock_grad(t);
+    }
+}
+
+static Value *build_tensor_sum(Tensor *t)
+{
+    if (!t || !tensor_check_contiguous(t, "sum"))
+        return NULL;
+
+    double total = 0.0;
+    for (size_t i = 0; i < t->size; i++)
+        total += t->data[i];
+
+    Value *out = value_create(total);
+    if (!out || !value_grad_enabled())
+        return out;
+
+    if (!value_alloc_prev(out, 1))
+    {
+        value_free(out);
+        return NULL;
+    }
+
+    out->prev[0] = t->node;
+    out->backward = backward_tensor_sum;
+    return out;
+}
+
+Value *tensor_sum(Tensor *t)
+{
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_tensor_sum(t);
+    PROFILE_TENSOR_END("sum");
+    return out;
+}
+
+#define CROSS_ENTROPY_EPSILON 1e-7
+
+static void backward_tensor_cross_entropy(Value *self)
+{
+    Tensor *probs = TENSOR(self->prev[0]);
+    const int *labels = self->backward_ctx;
+    size_t cols = probs->shape[probs->ndim - 1];
+    size_t rows = probs->size / cols;
+
+    if (tensor_lock_grad(probs))
+    {
+        for (size_t r = 0; r < rows; r++)
+        {
+            size_t idx = r * cols + labels[r];
+            probs->grad[idx] -= self->grad / (rows * (probs->data[idx] + CROSS_ENTROPY_EPSILON));
+        }
+        tensor_unlock_grad(probs);
+    }
+}
+
+static Value *build_tensor_cross_entropy(Tensor *probs, const int *labels)
+{
+    if (!probs || !labels || !tensor_check_contiguous(probs, "cross_entropy"))
+        return NULL;
+
+    size_t cols = probs->shape[probs->ndim - 1];
+    size_t rows = probs->size / cols;
+
+    double loss = 0.0;
+    for (size_t r = 0; r < rows; r++)
+    {
+        if (labels[r] < 0 || (size_t)labels[r] >= cols)
+        {
+            fprintf(stderr, "[ERROR] Label %d out of range in tensor_cross_entropy\n", labels[r]);
+            return NULL;
+        }
+        loss -= log(probs->data[r * cols + labels[r]] + CROSS_ENTROPY_EPSILON);
+    }
+
+    Value *out = value_create(loss / rows);
+    if (!out || !value_grad_enabled())
+        return out;
+
+    int *label_copy = value_alloc_ctx(out, rows * sizeof(int));
+    if (!label_copy || !value_alloc_prev(out, 1))
+    {
+        value_free(out);
+        return NULL;
+    }
+    memcpy(label_copy, labels, rows * sizeof(int));
+
+    out->prev[0] = probs->node;
+    out->backward = backward_tensor_cross_entropy;
+    return out;
+}
+
+Value *tensor_cross_entropy(Tensor *probs, const int *labels)
+{
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_tensor_cross_entropy(probs, labels);
+    PROFILE_TENSOR_END("cross_entropy");
+    return out;
+}
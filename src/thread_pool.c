@@ -0,0 +1,150 @@
+#include "../include/thread_pool.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct
+{
+    ThreadPool *pool;
+    int index;
+} WorkerArg;
+
+struct ThreadPool
+{
+    int num_threads;
+    pthread_t *threads;
+    WorkerArg *args;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    ThreadPoolFn fn;
+    void *ctx;
+    unsigned long generation;
+    int pending;
+    int shutdown;
+};
+
+static void *thread_pool_worker(void *arg)
+{
+    WorkerArg *worker = arg;
+    ThreadPool *pool = worker->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->shutdown && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->shutdown)
+            break;
+
+        seen = pool->generation;
+        ThreadPoolFn fn = pool->fn;
+        void *ctx = pool->ctx;
+        pthread_mutex_unlock(&pool->lock);
+
+        fn(ctx, worker->index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int thread_pool_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+ThreadPool *thread_pool_create(int num_threads)
+{
+    if (num_threads <= 0)
+        num_threads = thread_pool_default_threads();
+
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (!pool)
+        return NULL;
+
+    pool->num_threads = num_threads;
+    pool->threads = malloc(num_threads * sizeof(pthread_t));
+    pool->args = malloc(num_threads * sizeof(WorkerArg));
+    if (!pool->threads || !pool->args)
+    {
+        free(pool->threads);
+        free(pool->args);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 1; i < num_threads; i++)
+    {
+        pool->args[i].pool = pool;
+        pool->args[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, thread_pool_worker, &pool->args[i]) != 0)
+        {
+            pool->num_threads = i;
+            break;
+        }
+    }
+
+    return pool;
+}
+
+void thread_pool_free(ThreadPool *pool)
+{
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool->args);
+    free(pool);
+}
+
+int thread_pool_size(ThreadPool *pool)
+{
+    return pool ? pool->num_threads : 1;
+}
+
+void thread_pool_run(ThreadPool *pool, ThreadPoolFn fn, void *ctx)
+{
+    if (!pool || pool->num_threads == 1)
+    {
+        fn(ctx, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->pending = pool->num_threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    fn(ctx, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
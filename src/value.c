@@ -1,24 +1,100 @@
 #include "../include/value.h"
+#include "../include/tape.h"
+#include "../include/tensor.h"
+#include "../include/profile.h"
+#include "../include/fuse.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
+static _Thread_local int atomic_grads = 0;
+static _Thread_local int no_grad_depth = 0;
+static _Thread_local int lazy_depth = 0;
+
+typedef struct
+{
+    Value *node;
+    size_t next;
+} RealizeFrame;
+
+static _Thread_local RealizeFrame *realize_stack;
+static _Thread_local size_t realize_cap;
+
+void value_no_grad_begin(void)
+{
+    no_grad_depth++;
+}
+
+void value_no_grad_end(void)
+{
+    if (no_grad_depth > 0)
+        no_grad_depth--;
+}
+
+int value_grad_enabled(void)
+{
+    return no_grad_depth == 0;
+}
+
+void value_lazy_begin(void)
+{
+    lazy_depth++;
+}
+
+void value_lazy_end(void)
+{
+    if (lazy_depth > 0)
+        lazy_depth--;
+}
+
+int value_lazy_enabled(void)
+{
+    return lazy_depth > 0;
+}
+
+void value_set_atomic_grads(int enabled)
+{
+    atomic_grads = enabled;
+}
+
+int value_atomic_grads(void)
+{
+    return atomic_grads;
+}
+
+void value_grad_add(double *slot, double delta)
+{
+    if (!atomic_grads)
+    {
+        *slot += delta;
+        return;
+    }
+
+    double old, next;
+    __atomic_load(slot, &old, __ATOMIC_RELAXED);
+    do
+    {
+        next = old + delta;
+    } while (!__atomic_compare_exchange(slot, &old, &next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 void backward_add(Value *self)
 {
-    self->prev[0]->grad += self->grad;
-    self->prev[1]->grad += self->grad;
+    value_grad_add(&self->prev[0]->grad, self->grad);
+    value_grad_add(&self->prev[1]->grad, self->grad);
 }
 
 void backward_sub(Value *self)
 {
-    self->prev[0]->grad += self->grad;
-    self->prev[1]->grad -= self->grad;
+    value_grad_add(&self->prev[0]->grad, self->grad);
+    value_grad_add(&self->prev[1]->grad, -self->grad);
 }
 
 void backward_mul(Value *self)
 {
-    self->prev[0]->grad += self->prev[1]->data * self->grad;
-    self->prev[1]->grad += self->prev[0]->data * self->grad;
+    value_grad_add(&self->prev[0]->grad, self->prev[1]->data * self->grad);
+    value_grad_add(&self->prev[1]->grad, self->prev[0]->data * self->grad);
 }
 
 void backward_div(Value *self)
@@ -28,42 +104,103 @@ void backward_div(Value *self)
         fprintf(stderr, "[ERROR] Division by zero in backward_div\n");
         return;
     }
-    self->prev[0]->grad += self->grad / self->prev[1]->data;
-    self->prev[1]->grad -= (self->grad * self->prev[0]->data) / (self->prev[1]->data * self->prev[1]->data);
+    value_grad_add(&self->prev[0]->grad, self->grad / self->prev[1]->data);
+    value_grad_add(&self->prev[1]->grad, -(self->grad * self->prev[0]->data) / (self->prev[1]->data * self->prev[1]->data));
 }
 
 void backward_pow(Value *self)
 {
     double exponent = *(double *)self->backward_ctx;
-    self->prev[0]->grad += exponent * pow(self->prev[0]->data, exponent - 1) * self->grad;
+    value_grad_add(&self->prev[0]->grad, exponent * pow(self->prev[0]->data, exponent - 1) * self->grad);
 }
 
 void backward_relu(Value *self)
 {
-    self->prev[0]->grad += (self->prev[0]->data > 0 ? self->grad : 0);
+    value_grad_add(&self->prev[0]->grad, self->prev[0]->data > 0 ? self->grad : 0);
 }
 
 void backward_tanh(Value *self)
 {
     double t = tanh(self->prev[0]->data);
-    self->prev[0]->grad += (1 - t * t) * self->grad;
+    value_grad_add(&self->prev[0]->grad, (1 - t * t) * self->grad);
 }
 
-void backward_softmax(Value *self)
+void backward_sum(Value *self)
+{
+    for (size_t i = 0; i < self->prev_count; i++)
+        value_grad_add(&self->prev[i]->grad, self->grad);
+}
+
+void backward_dot(Value *self)
 {
-    int n = self->prev_count;
-    double softmax_i = self->data;
+    size_t n = self->prev_count / 2;
+    Value **a = self->prev;
+    Value **b = self->prev + n;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        value_grad_add(&a[i]->grad, b[i]->data * self->grad);
+        value_grad_add(&b[i]->grad, a[i]->data * self->grad);
+    }
+}
 
+static double log_sum_exp(Value **xs, int n)
+{
+    double max_val = xs[0]->data;
+    for (int i = 1; i < n; i++)
+    {
+        if (xs[i]->data > max_val)
+            max_val = xs[i]->data;
+    }
+
+    double sum = 0.0;
     for (int i = 0; i < n; i++)
+        sum += exp(xs[i]->data - max_val);
+    return max_val + log(sum);
+}
+
+void backward_softmax(Value *self)
+{
+    const SoftmaxCtx *ctx = self->backward_ctx;
+    double y = self->data;
+
+    for (size_t j = 0; j < self->prev_count; j++)
     {
-        double indicator = (self->prev[i] == self->prev[0]) ? 1.0 : 0.0;
-        self->prev[i]->grad += softmax_i * (indicator - self->prev[i]->data) * self->grad;
+        double indicator = (int)j == ctx->index ? 1.0 : 0.0;
+        double y_j = exp(self->prev[j]->data - ctx->log_sum);
+        value_grad_add(&self->prev[j]->grad, y * (indicator - y_j) * self->grad);
     }
 }
 
-Value *value_create(double data)
+void backward_softmax_cross_entropy(Value *self)
 {
-    Value *v = malloc(sizeof(Value));
+    const SoftmaxCtx *ctx = self->backward_ctx;
+
+    for (size_t j = 0; j < self->prev_count; j++)
+    {
+        double indicator = (int)j == ctx->index ? 1.0 : 0.0;
+        double p = exp(self->prev[j]->data - ctx->log_sum);
+        value_grad_add(&self->prev[j]->grad, (p - indicator) * self->grad);
+    }
+}
+
+/* Storage that hangs off a node comes from the tape the node itself was
+   recorded on, which need not be the tape active at the time. */
+static Tape *value_owner_tape(Value *v)
+{
+    return (v->flags & VALUE_FLAG_TAPE) ? v->tape : NULL;
+}
+
+static void *value_alloc(Tape *tape, size_t size)
+{
+    PROFILE_ALLOC(size);
+    return tape ? tape_alloc(tape, size) : malloc(size);
+}
+
+static Value *build_leaf(double data)
+{
+    Tape *tape = tape_active();
+    Value *v = value_alloc(tape, sizeof(Value));
     if (!v)
         return NULL;
     v->data = data;
@@ -72,17 +209,46 @@ Value *value_create(double data)
     v->prev_count = 0;
     v->backward = NULL;
     v->backward_ctx = NULL;
-    v->visited = 0;
+    v->topo = NULL;
+    v->topo_count = 0;
+    v->tape = tape;
+    v->flags = tape ? VALUE_FLAG_TAPE : 0;
     return v;
 }
 
+Value *value_create(double data)
+{
+    PROFILE_FORWARD_BEGIN();
+    Value *v = build_leaf(data);
+    PROFILE_FORWARD_END("", 1);
+    return v;
+}
+
+void *value_alloc_owned(Value *v, size_t size)
+{
+    return value_alloc(value_owner_tape(v), size);
+}
+
+Value **value_alloc_prev(Value *v, size_t n)
+{
+    v->prev = value_alloc_owned(v, n * sizeof(Value *));
+    if (!v->prev)
+        return NULL;
+    v->prev_count = n;
+    return v->prev;
+}
+
+void *value_alloc_ctx(Value *v, size_t size)
+{
+    v->backward_ctx = value_alloc_owned(v, size);
+    return v->backward_ctx;
+}
+
 void value_free(Value *v)
 {
-    if (!v)
+    if (!v || (v->flags & VALUE_FLAG_TAPE))
         return;
 
-    v->visited = 0;
-
     if (v->prev)
     {
         free(v->prev);
@@ -91,6 +257,10 @@ void value_free(Value *v)
     {
         free(v->backward_ctx);
     }
+    if (v->topo)
+    {
+        free(v->topo);
+    }
     free(v);
 }
 
@@ -99,238 +269,481 @@ void value_print(Value *v)
     printf("Value(data=%.4f, grad=%.4f)\n", v->data, v->grad);
 }
 
-Value *value_add(Value *a, Value *b)
+/* An op is only recorded, with data left as NaN, in lazy mode or when one
+   of its inputs is still pending. Without grad tracking the node keeps no
+   inputs to evaluate later, so pending inputs are realized instead. */
+int value_defer(Value **xs, size_t n)
 {
-    Value *out = value_create(a->data + b->data);
-    if (!out)
-        return NULL;
+    int lazy = lazy_depth > 0;
+    for (size_t i = 0; i < n && !lazy; i++)
+        lazy = (xs[i]->flags & VALUE_FLAG_LAZY) != 0;
+    if (!lazy || value_grad_enabled())
+        return lazy;
 
-    out->prev = malloc(2 * sizeof(Value *));
-    if (!out->prev)
+    for (size_t i = 0; i < n; i++)
     {
-        value_free(out);
-        return NULL;
+        if (xs[i]->flags & VALUE_FLAG_LAZY)
+            value_realize(xs[i]);
     }
-
-    out->prev[0] = a;
-    out->prev[1] = b;
-    out->prev_count = 2;
-    out->backward = backward_add;
-    return out;
+    return 0;
 }
 
-Value *value_sub(Value *a, Value *b)
+static Value *value_create_op(double data, size_t prev_count, BackwardFn backward, int lazy)
 {
-    Value *out = value_create(a->data - b->data);
-    if (!out)
-        return NULL;
+    Value *out = value_create(data);
+    if (!out || !value_grad_enabled())
+        return out;
 
-    out->prev = malloc(2 * sizeof(Value *));
-    if (!out->prev)
+    if (!value_alloc_prev(out, prev_count))
     {
         value_free(out);
         return NULL;
     }
 
-    out->prev[0] = a;
-    out->prev[1] = b;
-    out->prev_count = 2;
-    out->backward = backward_sub;
+    out->backward = backward;
+    if (lazy)
+        out->flags |= VALUE_FLAG_LAZY;
     return out;
 }
 
-Value *value_mul(Value *a, Value *b)
+static Value *value_binary_op(Value *a, Value *b, double data, BackwardFn backward, int lazy)
 {
-    Value *out = value_create(a->data * b->data);
-    if (!out)
-        return NULL;
-
-    out->prev = malloc(2 * sizeof(Value *));
-    if (!out->prev)
-    {
-        value_free(out);
-        return NULL;
-    }
+    Value *out = value_create_op(data, 2, backward, lazy);
+    if (!out || !out->prev)
+        return out;
 
     out->prev[0] = a;
     out->prev[1] = b;
-    out->prev_count = 2;
-    out->backward = backward_mul;
     return out;
 }
 
-Value *value_div(Value *a, Value *b)
+static Value *value_unary_op(Value *x, double data, BackwardFn backward, int lazy)
 {
-    Value *out = value_create(a->data / b->data);
-    if (!out)
-        return NULL;
+    Value *out = value_create_op(data, 1, backward, lazy);
+    if (!out || !out->prev)
+        return out;
 
-    out->prev = malloc(2 * sizeof(Value *));
-    if (!out->prev)
-    {
-        value_free(out);
-        return NULL;
-    }
+    out->prev[0] = x;
+    return out;
+}
 
-    out->prev[0] = a;
-    out->prev[1] = b;
-    out->prev_count = 2;
-    out->backward = backward_div;
+Value *value_add(Value *a, Value *b)
+{
+    PROFILE_FORWARD_BEGIN();
+    int lazy = value_defer((Value *[]){a, b}, 2);
+    Value *out = value_binary_op(a, b, lazy ? NAN : a->data + b->data, backward_add, lazy);
+    PROFILE_FORWARD_END("+", 1);
     return out;
 }
 
-Value *value_relu(Value *x)
+Value *value_sub(Value *a, Value *b)
 {
-    Value *out = value_create(x->data > 0 ? x->data : 0);
-    if (!out)
-        return NULL;
+    PROFILE_FORWARD_BEGIN();
+    int lazy = value_defer((Value *[]){a, b}, 2);
+    Value *out = value_binary_op(a, b, lazy ? NAN : a->data - b->data, backward_sub, lazy);
+    PROFILE_FORWARD_END("-", 1);
+    return out;
+}
 
-    out->prev = malloc(sizeof(Value *));
-    if (!out->prev)
-    {
-        value_free(out);
-        return NULL;
-    }
+Value *value_mul(Value *a, Value *b)
+{
+    PROFILE_FORWARD_BEGIN();
+    int lazy = value_defer((Value *[]){a, b}, 2);
+    Value *out = value_binary_op(a, b, lazy ? NAN : a->data * b->data, backward_mul, lazy);
+    PROFILE_FORWARD_END("*", 1);
+    return out;
+}
 
-    out->prev[0] = x;
-    out->prev_count = 1;
-    out->backward = backward_relu;
+Value *value_div(Value *a, Value *b)
+{
+    PROFILE_FORWARD_BEGIN();
+    int lazy = value_defer((Value *[]){a, b}, 2);
+    Value *out = value_binary_op(a, b, lazy ? NAN : a->data / b->data, backward_div, lazy);
+    PROFILE_FORWARD_END("/", 1);
+    return out;
+}
+
+Value *value_relu(Value *x)
+{
+    PROFILE_FORWARD_BEGIN();
+    int lazy = value_defer(&x, 1);
+    Value *out = value_unary_op(x, lazy ? NAN : x->data > 0 ? x->data : 0, backward_relu, lazy);
+    PROFILE_FORWARD_END("ReLU", 1);
     return out;
 }
 
 Value *value_tanh(Value *x)
 {
-    Value *out = value_create(tanh(x->data));
-    if (!out)
-        return NULL;
+    PROFILE_FORWARD_BEGIN();
+    int lazy = value_defer(&x, 1);
+    Value *out = value_unary_op(x, lazy ? NAN : tanh(x->data), backward_tanh, lazy);
+    PROFILE_FORWARD_END("tanh", 1);
+    return out;
+}
+
+static Value *build_pow(Value *base, double exponent)
+{
+    int lazy = value_defer(&base, 1);
+    Value *out = value_unary_op(base, lazy ? NAN : pow(base->data, exponent), backward_pow, lazy);
+    if (!out || !out->prev)
+        return out;
 
-    out->prev = malloc(sizeof(Value *));
-    if (!out->prev)
+    double *exp_ptr = value_alloc_ctx(out, sizeof(double));
+    if (!exp_ptr)
     {
         value_free(out);
         return NULL;
     }
-
-    out->prev[0] = x;
-    out->prev_count = 1;
-    out->backward = backward_tanh;
+    *exp_ptr = exponent;
     return out;
 }
 
 Value *value_pow(Value *base, double exponent)
 {
-    Value *out = value_create(pow(base->data, exponent));
-    if (!out)
-        return NULL;
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_pow(base, exponent);
+    PROFILE_FORWARD_END("^", 1);
+    return out;
+}
 
-    out->prev = malloc(sizeof(Value *));
-    if (!out->prev)
-    {
-        value_free(out);
-        return NULL;
-    }
+static Value *build_sum(Value **xs, int n)
+{
+    int lazy = value_defer(xs, n);
+    double total = lazy ? NAN : 0.0;
+    for (int i = 0; i < n && !lazy; i++)
+        total += xs[i]->data;
 
-    double *exp_ptr = malloc(sizeof(double));
-    if (!exp_ptr)
-    {
-        value_free(out);
-        return NULL;
-    }
-    *exp_ptr = exponent;
+    Value *out = value_create_op(total, n, backward_sum, lazy);
+    if (!out || !out->prev)
+        return out;
 
-    out->prev[0] = base;
-    out->prev_count = 1;
-    out->backward = backward_pow;
-    out->backward_ctx = exp_ptr;
+    memcpy(out->prev, xs, n * sizeof(Value *));
     return out;
 }
 
-Value **value_softmax(Value **inputs, int n)
+Value *value_sum(Value **xs, int n)
 {
-    double max_val = inputs[0]->data;
-    for (int i = 1; i < n; i++)
-    {
-        if (inputs[i]->data > max_val)
-        {
-            max_val = inputs[i]->data;
-        }
-    }
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_sum(xs, n);
+    PROFILE_FORWARD_END("sum", 1);
+    return out;
+}
 
-    double sum = 0.0;
-    double *exp_values = malloc(n * sizeof(double));
-    if (!exp_values)
-        return NULL;
+static Value *build_dot(Value **a, Value **b, int n)
+{
+    int lazy = value_defer(a, n) | value_defer(b, n);
+    double total = lazy ? NAN : 0.0;
+    for (int i = 0; i < n && !lazy; i++)
+        total += a[i]->data * b[i]->data;
 
-    for (int i = 0; i < n; i++)
-    {
-        exp_values[i] = exp(inputs[i]->data - max_val);
-        sum += exp_values[i];
-    }
+    Value *out = value_create_op(total, 2 * (size_t)n, backward_dot, lazy);
+    if (!out || !out->prev)
+        return out;
+
+    memcpy(out->prev, a, n * sizeof(Value *));
+    memcpy(out->prev + n, b, n * sizeof(Value *));
+    return out;
+}
+
+Value *value_dot(Value **a, Value **b, int n)
+{
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_dot(a, b, n);
+    PROFILE_FORWARD_END("dot", 1);
+    return out;
+}
+
+static Value **build_softmax(Value **inputs, int n)
+{
+    int lazy = value_defer(inputs, n);
+    double log_sum = lazy ? NAN : log_sum_exp(inputs, n);
 
     Value **outputs = malloc(n * sizeof(Value *));
     if (!outputs)
-    {
-        free(exp_values);
         return NULL;
-    }
 
     for (int i = 0; i < n; i++)
     {
-        outputs[i] = value_create(exp_values[i] / sum);
+        outputs[i] = value_create_op(lazy ? NAN : exp(inputs[i]->data - log_sum), n, backward_softmax, lazy);
         if (!outputs[i])
         {
             for (int j = 0; j < i; j++)
                 value_free(outputs[j]);
             free(outputs);
-            free(exp_values);
             return NULL;
         }
-
-        outputs[i]->prev = malloc(n * sizeof(Value *));
         if (!outputs[i]->prev)
+            continue;
+
+        SoftmaxCtx *ctx = value_alloc_ctx(outputs[i], sizeof(SoftmaxCtx));
+        if (!ctx)
         {
             for (int j = 0; j <= i; j++)
-            {
-                if (outputs[j]->prev)
-                    free(outputs[j]->prev);
                 value_free(outputs[j]);
-            }
             free(outputs);
-            free(exp_values);
             return NULL;
         }
+        ctx->index = i;
+        ctx->log_sum = log_sum;
+        memcpy(outputs[i]->prev, inputs, n * sizeof(Value *));
+    }
+
+    return outputs;
+}
+
+Value **value_softmax(Value **inputs, int n)
+{
+    PROFILE_FORWARD_BEGIN();
+    Value **out = build_softmax(inputs, n);
+    PROFILE_FORWARD_END("softmax", (size_t)n);
+    return out;
+}
+
+static Value *build_softmax_cross_entropy(Value **logits, int label, int n)
+{
+    if (label < 0 || label >= n)
+    {
+        fprintf(stderr, "[ERROR] Label %d out of range in value_softmax_cross_entropy\n", label);
+        return NULL;
+    }
+
+    int lazy = value_defer(logits, n);
+    double log_sum = lazy ? NAN : log_sum_exp(logits, n);
+    Value *out = value_create_op(lazy ? NAN : log_sum - logits[label]->data, n,
+                                 backward_softmax_cross_entropy, lazy);
+    if (!out || !out->prev)
+        return out;
+
+    SoftmaxCtx *ctx = value_alloc_ctx(out, sizeof(SoftmaxCtx));
+    if (!ctx)
+    {
+        value_free(out);
+        return NULL;
+    }
+    ctx->index = label;
+    ctx->log_sum = log_sum;
+    memcpy(out->prev, logits, n * sizeof(Value *));
+    return out;
+}
+
+Value *value_softmax_cross_entropy(Value **logits, int label, int n)
+{
+    PROFILE_FORWARD_BEGIN();
+    Value *out = build_softmax_cross_entropy(logits, label, n);
+    PROFILE_FORWARD_END("softmax_ce", 1);
+    return out;
+}
+
+static int value_same_inputs(const Value *a, const Value *b)
+{
+    return a && a->prev_count == b->prev_count &&
+           memcmp(a->prev, b->prev, a->prev_count * sizeof(Value *)) == 0;
+}
+
+static void value_eval(Value *v, Value *softmax)
+{
+    Value **p = v->prev;
+    int n = (int)v->prev_count;
+
+    switch (value_get_op(v))
+    {
+    case VALUE_OP_ADD:
+        v->data = p[0]->data + p[1]->data;
+        break;
+    case VALUE_OP_SUB:
+        v->data = p[0]->data - p[1]->data;
+        break;
+    case VALUE_OP_MUL:
+        v->data = p[0]->data * p[1]->data;
+        break;
+    case VALUE_OP_DIV:
+        v->data = p[0]->data / p[1]->data;
+        break;
+    case VALUE_OP_POW:
+        v->data = pow(p[0]->data, *(double *)v->backward_ctx);
+        break;
+    case VALUE_OP_RELU:
+        v->data = p[0]->data > 0 ? p[0]->data : 0;
+        break;
+    case VALUE_OP_TANH:
+        v->data = tanh(p[0]->data);
+        break;
+    case VALUE_OP_SUM:
+        v->data = 0.0;
+        for (int i = 0; i < n; i++)
+            v->data += p[i]->data;
+        break;
+    case VALUE_OP_DOT:
+        v->data = 0.0;
+        for (int i = 0; i < n / 2; i++)
+            v->data += p[i]->data * p[n / 2 + i]->data;
+        break;
+    case VALUE_OP_SOFTMAX:
+    {
+        SoftmaxCtx *ctx = v->backward_ctx;
+        ctx->log_sum = value_same_inputs(softmax, v) ? ((SoftmaxCtx *)softmax->backward_ctx)->log_sum
+                                                     : log_sum_exp(p, n);
+        v->data = exp(p[ctx->index]->data - ctx->log_sum);
+        break;
+    }
+    case VALUE_OP_SOFTMAX_CE:
+    {
+        SoftmaxCtx *ctx = v->backward_ctx;
+        ctx->log_sum = log_sum_exp(p, n);
+        v->data = ctx->log_sum - p[ctx->index]->data;
+        break;
+    }
+    case VALUE_OP_FUSED:
+    {
+        const FusedKernel *k = *(const FusedKernel **)v->backward_ctx;
+        double inputs[FUSE_MAX_INPUTS], regs[FUSE_MAX_CODE];
+        for (int i = 0; i < n; i++)
+            inputs[i] = p[i]->data;
+        v->data = fused_forward(k, inputs, regs);
+        break;
+    }
+    default:
+        break;
+    }
+    v->flags &= ~VALUE_FLAG_LAZY;
+}
+
+/* Evaluates the pending nodes of a topological order in one pass. The
+   outputs of one softmax share their inputs, so the log-sum-exp of the
+   previous one is reused when the inputs match. */
+void value_realize_topo(Value **topo, size_t count)
+{
+    Value *softmax = NULL;
+    for (size_t i = 0; i < count; i++)
+    {
+        Value *v = topo[i];
+        if (!(v->flags & VALUE_FLAG_LAZY))
+            continue;
+        value_eval(v, softmax);
+        if (v->backward == backward_softmax)
+            softmax = v;
+    }
+}
+
+static int realize_push(size_t depth, Value *v)
+{
+    if (depth == realize_cap)
+    {
+        size_t cap = realize_cap ? 2 * realize_cap : 256;
+        RealizeFrame *grown = realloc(realize_stack, cap * sizeof(RealizeFrame));
+        if (!grown)
+        {
+            fprintf(stderr, "[ERROR] Memory allocation failed in value_realize\n");
+            return 0;
+        }
+        realize_stack = grown;
+        realize_cap = cap;
+    }
+    realize_stack[depth] = (RealizeFrame){v, 0};
+    return 1;
+}
 
-        for (int j = 0; j < n; j++)
+/* Walks pending nodes only. A node stops being pending once evaluated, so
+   the flag doubles as the visited mark and computed parts of the graph are
+   never entered. */
+double value_realize(Value *v)
+{
+    if (!v || !(v->flags & VALUE_FLAG_LAZY))
+        return v ? v->data : 0.0;
+
+    Value *softmax = NULL;
+    size_t depth = 0;
+    if (!realize_push(depth++, v))
+        return NAN;
+
+    while (depth > 0)
+    {
+        RealizeFrame *top = &realize_stack[depth - 1];
+        Value *node = top->node;
+        if (top->next < node->prev_count)
         {
-            outputs[i]->prev[j] = inputs[j];
+            Value *parent = node->prev[top->next++];
+            if ((parent->flags & VALUE_FLAG_LAZY) && !realize_push(depth++, parent))
+                return NAN;
+            continue;
         }
-        outputs[i]->prev_count = n;
-        outputs[i]->backward = backward_softmax;
+
+        value_eval(node, softmax);
+        if (node->backward == backward_softmax)
+            softmax = node;
+        depth--;
     }
+    return v->data;
+}
 
-    free(exp_values);
-    return outputs;
+ValueOp value_get_op(Value *v)
+{
+    if (v->flags & VALUE_FLAG_TENSOR)
+        return VALUE_OP_TENSOR;
+    if (!v->backward)
+        return VALUE_OP_LEAF;
+    if (v->backward == backward_add)
+        return VALUE_OP_ADD;
+    if (v->backward == backward_sub)
+        return VALUE_OP_SUB;
+    if (v->backward == backward_mul)
+        return VALUE_OP_MUL;
+    if (v->backward == backward_div)
+        return VALUE_OP_DIV;
+    if (v->backward == backward_pow)
+        return VALUE_OP_POW;
+    if (v->backward == backward_relu)
+        return VALUE_OP_RELU;
+    if (v->backward == backward_tanh)
+        return VALUE_OP_TANH;
+    if (v->backward == backward_sum)
+        return VALUE_OP_SUM;
+    if (v->backward == backward_dot)
+        return VALUE_OP_DOT;
+    if (v->backward == backward_softmax)
+        return VALUE_OP_SOFTMAX;
+    if (v->backward == backward_softmax_cross_entropy)
+        return VALUE_OP_SOFTMAX_CE;
+    if (v->backward == backward_fused)
+        return VALUE_OP_FUSED;
+    return VALUE_OP_CUSTOM;
 }
 
 const char *value_get_op_symbol(Value *v)
 {
-    if (!v->backward)
+    switch (value_get_op(v))
+    {
+    case VALUE_OP_LEAF:
         return "";
-    if (v->backward == backward_add)
+    case VALUE_OP_ADD:
         return "+";
-    if (v->backward == backward_mul)
-        return "*";
-    if (v->backward == backward_sub)
+    case VALUE_OP_SUB:
         return "-";
-    if (v->backward == backward_div)
+    case VALUE_OP_MUL:
+        return "*";
+    case VALUE_OP_DIV:
         return "/";
-    if (v->backward == backward_relu)
-        return "ReLU";
-    if (v->backward == backward_pow)
+    case VALUE_OP_POW:
         return "^";
-    if (v->backward == backward_tanh)
+    case VALUE_OP_RELU:
+        return "ReLU";
+    case VALUE_OP_TANH:
         return "tanh";
-    return "?";
+    case VALUE_OP_SUM:
+        return "sum";
+    case VALUE_OP_DOT:
+        return "dot";
+    case VALUE_OP_SOFTMAX:
+        return "softmax";
+    case VALUE_OP_SOFTMAX_CE:
+        return "softmax_ce";
+    case VALUE_OP_FUSED:
+        return "fused";
+    case VALUE_OP_TENSOR:
+        return tensor_get_op_symbol(v);
+    default:
+        return "?";
+    }
 }
 
 void value_get_label(Value *v, char *buf, size_t size)